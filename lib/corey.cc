@@ -1,26 +1,52 @@
 #include "corey.hh"
 #include "console.hh"
+#include "reactor/coroutine.hh"
 #include "reactor/task.hh"
 #include "sink.hh"
 
 #include <cxxopts.hpp>
 
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
 namespace corey {
 
 Application::Application(int argc, char* argv[], ApplicationInfo&& info)
-    : _ioEngine(_reactor)
-    , _info(std::move(info))
+    : _info(std::move(info))
     , _argc(argc)
     , _argv(argv)
     , _options(_info.name, _info.description) {
 
     _options.add_options()
         ("h,help", "Print help")
-        ("v,version", "Print version");
+        ("v,version", "Print version")
+        ("smp", "Number of shards, one thread per shard", cxxopts::value<unsigned>())
+        ("cpuset", "CPUs to pin shards to, e.g. 0-3,8", cxxopts::value<std::string>())
+        ("numa-aware", "Allocate shard memory from NUMA node of its CPU")
+        ("stall-threshold-ms", "Log backtrace of tasks blocking reactor longer than this", cxxopts::value<unsigned>())
+        ("idle-policy", "What idle shard does: block, spin or poll", cxxopts::value<std::string>())
+        ("idle-spin-us", "How long idle shard polls before blocking with --idle-policy=spin", cxxopts::value<unsigned>())
+        ("io-sq-entries", "io_uring submission queue size of every shard", cxxopts::value<unsigned>())
+        ("io-cq-entries", "io_uring completion queue size of every shard", cxxopts::value<unsigned>())
+        ("io-single-issuer", "Set up io_uring with IORING_SETUP_SINGLE_ISSUER")
+        ("io-defer-taskrun", "Set up io_uring with IORING_SETUP_DEFER_TASKRUN, implies --io-single-issuer")
+        ("io-coop-taskrun", "Set up io_uring with IORING_SETUP_COOP_TASKRUN")
+        ("io-submit-all", "Set up io_uring with IORING_SETUP_SUBMIT_ALL")
+        ("io-sqpoll", "Submit io_uring requests by kernel thread polling submission queue")
+        ("io-sqpoll-idle-ms", "How long idle SQ thread polls before sleeping with --io-sqpoll", cxxopts::value<unsigned>())
+        ("io-sqpoll-cpu", "CPU to pin SQ thread to with --io-sqpoll", cxxopts::value<unsigned>());
     _options.show_positional_help();
 }
 
-Application::~Application() { ; }
+Application::~Application() {
+    // engine completes in-flight requests with -ECANCELED, their awaiters
+    // must run before reactor is destroyed
+    _ioEngine.reset();
+    while (_reactor.has_progress()) {
+        _reactor.run();
+    }
+}
 
 cxxopts::ParseResult Application::get_parse_result() {
     if (_argc > 0) {
@@ -30,11 +56,125 @@ cxxopts::ParseResult Application::get_parse_result() {
     return _options.parse(1, argv);
 }
 
+IoEngineConfig Application::io_config(const ParseResult& opts) {
+    IoEngineConfig config;
+    if (opts.count("io-sq-entries")) {
+        config.sq_entries = opts["io-sq-entries"].as<unsigned>();
+        if (config.sq_entries == 0) {
+            throw std::invalid_argument("--io-sq-entries must be positive");
+        }
+    }
+    if (opts.count("io-cq-entries")) {
+        config.cq_entries = opts["io-cq-entries"].as<unsigned>();
+        if (config.cq_entries < config.sq_entries) {
+            throw std::invalid_argument("--io-cq-entries must not be less than --io-sq-entries");
+        }
+    }
+    config.single_issuer = opts.count("io-single-issuer") > 0;
+    config.defer_taskrun = opts.count("io-defer-taskrun") > 0;
+    config.coop_taskrun = opts.count("io-coop-taskrun") > 0;
+    config.submit_all = opts.count("io-submit-all") > 0;
+    config.sq_poll = opts.count("io-sqpoll") > 0;
+    if (opts.count("io-sqpoll-idle-ms")) {
+        config.sq_thread_idle = std::chrono::milliseconds(opts["io-sqpoll-idle-ms"].as<unsigned>());
+    }
+    if (opts.count("io-sqpoll-cpu")) {
+        config.sq_thread_cpu = opts["io-sqpoll-cpu"].as<unsigned>();
+    }
+    if (!config.sq_poll && (opts.count("io-sqpoll-idle-ms") || opts.count("io-sqpoll-cpu"))) {
+        throw std::invalid_argument("--io-sqpoll-idle-ms and --io-sqpoll-cpu require --io-sqpoll");
+    }
+    return config;
+}
+
+Defer<> Application::start_shards(const ParseResult& opts) {
+    auto io = io_config(opts);
+
+    std::vector<unsigned> cpus;
+    if (opts.count("cpuset")) {
+        cpus = parse_cpuset(opts["cpuset"].as<std::string>());
+    }
+    if (opts.count("smp")) {
+        auto smp = opts["smp"].as<unsigned>();
+        if (smp == 0) {
+            throw std::invalid_argument("--smp must be positive");
+        }
+        if (cpus.empty()) {
+            auto available = get_thread_cpus();
+            for (unsigned id = 0; id < smp; ++id) {
+                cpus.push_back(available[id % available.size()]);
+            }
+        } else if (smp > cpus.size()) {
+            throw std::invalid_argument("--smp is greater than --cpuset size");
+        } else {
+            cpus.resize(smp);
+        }
+    }
+    SmpOptions smp_options{ .numa_aware = opts.count("numa-aware") > 0, .io = io };
+    if (smp_options.numa_aware && cpus.empty()) {
+        throw std::invalid_argument("--numa-aware requires --smp or --cpuset");
+    }
+
+    // with shards IoEngine of this thread is created by Smp once the thread
+    // is pinned to its cpu and node
+    if (cpus.empty()) {
+        _ioEngine.emplace(_reactor, io);
+    }
+    setup_shard(opts);
+    std::unique_ptr<Smp> smp;
+    if (!cpus.empty()) {
+        smp = std::make_unique<Smp>(cpus, [this, &opts] {
+            setup_shard(opts);
+            return run_shard_services(opts);
+        }, smp_options);
+    }
+    _local_services.emplace(run_shard_services(opts));
+    return defer([smp = std::move(smp)]() mutable noexcept {
+        smp.reset();
+    });
+}
+
+void Application::setup_shard(const ParseResult& opts) {
+    if (opts.count("stall-threshold-ms")) {
+        auto threshold = opts["stall-threshold-ms"].as<unsigned>();
+        if (threshold == 0) {
+            throw std::invalid_argument("--stall-threshold-ms must be positive");
+        }
+        Reactor::instance().enable_stall_detector(std::chrono::milliseconds(threshold));
+    }
+    if (opts.count("idle-policy") || opts.count("idle-spin-us")) {
+        auto& reactor = Reactor::instance();
+        auto policy = reactor.idle_policy();
+        if (opts.count("idle-policy")) {
+            policy = parse_idle_policy(opts["idle-policy"].as<std::string>());
+        }
+        auto spin = reactor.spin_window();
+        if (opts.count("idle-spin-us")) {
+            spin = std::chrono::microseconds(opts["idle-spin-us"].as<unsigned>());
+        }
+        reactor.set_idle_policy(policy, spin);
+    }
+}
+
+Future<> Application::run_shard_services(const ParseResult& opts) {
+    std::vector<Future<>> running;
+    for (auto& service: _services) {
+        running.push_back(service(opts));
+    }
+    for (auto& service: running) {
+        co_await std::move(service);
+    }
+}
+
 int Application::run(Future<int>&& task) {
     while (task.is_ready() == false) {
         _reactor.run();
     }
-    return task.get();
+    auto result = task.get();
+    if (_local_services && _local_services->is_ready() && _local_services->has_failed()) {
+        std::rethrow_exception(_local_services->get_exception());
+    }
+    return result;
 }
 
 } // namespace corey
@@ -8,6 +8,7 @@
 #include "reactor/coroutine.hh"
 #include "reactor/timer.hh"
 #include "reactor/sync.hh"
+#include "reactor/smp.hh"
 
 #include "common/sink.hh"
 #include "common/console.hh"
@@ -15,6 +16,9 @@
 #include <cxxopts.hpp>
 
 #include <concepts>
+#include <functional>
+#include <optional>
+#include <vector>
 
 namespace corey {
 
@@ -32,6 +36,8 @@ concept MainFunc = requires(Func func, ParseResult result, Args&&... args) {
     { func(result, std::forward<Args>(args)...) } -> std::same_as<Future<int>>;
 };
 
+using ShardService = std::function<Future<>(const ParseResult&)>;
+
 class Application {
 public:
     Application(int argc, char* argv[], ApplicationInfo&& info = {});
@@ -48,6 +54,10 @@ public:
 
     void set_positional_help(const std::string& help);
 
+    // Service is started on every shard before main function,
+    // shards are stopped when main function completes.
+    void add_shard_service(ShardService&& service);
+
     template<typename Func, typename... Args>
     requires MainFunc<Func, Args...>
     int run(Func&& func, Args&&... args);
@@ -56,15 +66,25 @@ private:
 
     ParseResult get_parse_result();
 
+    IoEngineConfig io_config(const ParseResult&);
+    Defer<> start_shards(const ParseResult&);
+    Future<> run_shard_services(const ParseResult&);
+    void setup_shard(const ParseResult&);
+
     int run(Future<int>&& task);
 
     Reactor _reactor;
-    IoEngine _ioEngine;
+    // created once options are parsed, its ring setup is configurable;
+    // with shards Smp creates it instead
+    std::optional<IoEngine> _ioEngine;
+    // services of shard 0, their failure is rethrown by run()
+    std::optional<Future<>> _local_services;
 
     ApplicationInfo _info;
     int _argc;
     char** _argv;
     cxxopts::Options _options;
+    std::vector<ShardService> _services;
 };
 
 inline cxxopts::OptionAdder Application::add_options() {
@@ -80,6 +100,10 @@ inline void Application::set_positional_help(const std::string& help) {
     _options.positional_help(help);
 }
 
+inline void Application::add_shard_service(ShardService&& service) {
+    _services.push_back(std::move(service));
+}
+
 template<typename Func, typename... Args>
 requires MainFunc<Func, Args...>
 inline int Application::run(Func&& func, Args&&... args) {
@@ -94,6 +118,7 @@ inline int Application::run(Func&& func, Args&&... args) {
         sink.write(fmt::format("{}\n", _info.version));
         return 0;
     }
+    auto shards = start_shards(parse_results);
     return run(func(parse_results, std::forward<Args>(args)...));
 }
 
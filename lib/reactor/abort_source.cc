@@ -0,0 +1,28 @@
+#include "abort_source.hh"
+
+#include <utility>
+
+namespace corey {
+
+void AbortSource::request_abort() {
+    if (_requested) {
+        return;
+    }
+    _requested = true;
+    // subscriptions removed after this point don't touch the list
+    auto callbacks = std::exchange(_callbacks, {});
+    for (auto& callback: callbacks) {
+        callback();
+    }
+}
+
+Defer<> AbortSource::subscribe(std::function<void()>&& callback) {
+    auto it = _callbacks.insert(_callbacks.end(), std::move(callback));
+    return defer([this, it]() noexcept {
+        if (!_requested) {
+            _callbacks.erase(it);
+        }
+    });
+}
+
+} // namespace corey
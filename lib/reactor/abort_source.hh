@@ -0,0 +1,32 @@
+#pragma once
+
+#include "common/defer.hh"
+
+#include <functional>
+#include <list>
+
+namespace corey {
+
+// Requests abort of operations it was passed to. Abort source must outlive
+// operations using it.
+class AbortSource {
+public:
+
+    AbortSource() = default;
+    AbortSource(const AbortSource&) = delete;
+    AbortSource& operator=(const AbortSource&) = delete;
+
+    // Calls subscribed callbacks once, in order of subscription.
+    void request_abort();
+
+    bool abort_requested() const noexcept { return _requested; }
+
+    // Callback is not called if returned Defer is destroyed before abort.
+    Defer<> subscribe(std::function<void()>&& callback);
+
+private:
+    std::list<std::function<void()>> _callbacks;
+    bool _requested = false;
+};
+
+} // namespace corey
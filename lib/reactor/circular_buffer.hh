@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace corey {
+
+// Growable FIFO ring. Capacity doubles when ring is full and is never
+// returned, so once queue has reached its working size push and pop do
+// not allocate.
+template<typename Data>
+class CircularBuffer {
+public:
+    static constexpr std::size_t min_capacity = 16;
+
+    CircularBuffer() noexcept = default;
+    CircularBuffer(const CircularBuffer&) = delete;
+    CircularBuffer& operator=(const CircularBuffer&) = delete;
+
+    CircularBuffer(CircularBuffer&& other) noexcept
+        : _items(std::exchange(other._items, nullptr))
+        , _capacity(std::exchange(other._capacity, 0))
+        , _head(std::exchange(other._head, 0))
+        , _tail(std::exchange(other._tail, 0)) {}
+
+    CircularBuffer& operator=(CircularBuffer&& other) noexcept {
+        if (this != &other) {
+            this->~CircularBuffer();
+            new (this) CircularBuffer(std::move(other));
+        }
+        return *this;
+    }
+
+    ~CircularBuffer() {
+        clear();
+        if (_items) {
+            std::allocator<Data>().deallocate(_items, _capacity);
+        }
+    }
+
+    bool empty() const noexcept { return _head == _tail; }
+    std::size_t size() const noexcept { return _tail - _head; }
+    std::size_t capacity() const noexcept { return _capacity; }
+
+    void push_back(Data&& data) {
+        if (size() == _capacity) {
+            grow();
+        }
+        new (slot(_tail)) Data(std::move(data));
+        ++_tail;
+    }
+
+    Data& front() noexcept { return *slot(_head); }
+
+    void pop_front() noexcept {
+        std::destroy_at(slot(_head));
+        ++_head;
+    }
+
+    void clear() noexcept {
+        while (!empty()) {
+            pop_front();
+        }
+    }
+
+private:
+    // Capacity is a power of two, so indices wrap with a mask.
+    Data* slot(std::size_t idx) const noexcept { return _items + (idx & (_capacity - 1)); }
+
+    void grow() {
+        auto capacity = std::max(min_capacity, _capacity * 2);
+        auto items = std::allocator<Data>().allocate(capacity);
+        auto count = size();
+        for (std::size_t idx = 0; idx < count; ++idx) {
+            new (items + idx) Data(std::move(*slot(_head + idx)));
+            std::destroy_at(slot(_head + idx));
+        }
+        if (_items) {
+            std::allocator<Data>().deallocate(_items, _capacity);
+        }
+        _items = items;
+        _capacity = capacity;
+        _head = 0;
+        _tail = count;
+    }
+
+    Data* _items = nullptr;
+    std::size_t _capacity = 0;
+    std::size_t _head = 0;
+    std::size_t _tail = 0;
+};
+
+} // namespace corey
@@ -1,13 +1,19 @@
 #pragma once
 
+#include "reactor/frame_allocator.hh"
 #include "reactor/future.hh"
 #include "reactor/reactor.hh"
 #include "reactor/task.hh"
 #include "utils/log.hh"
 
 #include <coroutine>
+#include <cstddef>
 #include <exception>
+#include <memory>
+#include <optional>
+#include <system_error>
 #include <type_traits>
+#include <utility>
 
 namespace corey {
 
@@ -15,32 +21,37 @@ struct Yield {};
 
 inline constexpr Yield yield() { return {}; }
 
+// Suspends only when task quota is exhausted, see need_preempt().
+struct MaybeYield {};
+
+inline constexpr MaybeYield maybe_yield() { return {}; }
+
+template<typename Data = void>
+class Task;
+
+template<typename Data>
+class GeneratorNext;
+
+// Frame allocation and awaitables shared by all coroutine promise types.
 template<typename Self>
-struct BaseCoroPromise {
-    auto get_return_object() {
-        return static_cast<Self*>(this)->_promise.get_future();
+struct AwaitingPromise {
+#ifndef COREY_SYSTEM_FRAME_ALLOCATOR
+    static void* operator new(std::size_t size) {
+        return allocate_frame<Self>(size);
     }
 
-    [[nodiscard]] constexpr std::suspend_never initial_suspend() noexcept { return {}; }
-    [[nodiscard]] constexpr std::suspend_never final_suspend() noexcept { return {}; }
-
-    void unhandled_exception() {
-        if (!static_cast<Self*>(this)->_promise.has_future()) {
-            log_orphaned_exception(std::current_exception());
-        }
-        static_cast<Self*>(this)->_promise.set_exception(std::current_exception());
+    static void operator delete(void* ptr, std::size_t size) noexcept {
+        deallocate_frame(ptr, size);
     }
+#endif
 
     template<typename FutData>
     auto await_transform(corey::Future<FutData>&& future) {
         struct Awaiter {
             corey::Future<FutData> future;
             bool await_ready() const noexcept { return future.is_ready(); }
-            void await_suspend(std::coroutine_handle<> handle) noexcept {
-                corey::Reactor::instance().add_task(make_task(
-                    [handle]() { handle.resume(); },
-                    [this]() { return future.is_ready(); }
-                ));
+            void await_suspend(std::coroutine_handle<> handle) {
+                future.set_continuation(handle);
             }
             FutData await_resume() {
                 return future.get();
@@ -49,24 +60,56 @@ struct BaseCoroPromise {
         return Awaiter{ std::move(future) };
     }
 
+    template<typename FutData>
+    auto await_transform(corey::SharedFuture<FutData> future) {
+        struct Awaiter {
+            corey::SharedFuture<FutData> future;
+            bool await_ready() const noexcept { return future.is_ready(); }
+            void await_suspend(std::coroutine_handle<> handle) {
+                future.add_waiter(handle);
+            }
+            decltype(auto) await_resume() const {
+                return future.get();
+            }
+        };
+        return Awaiter{ std::move(future) };
+    }
+
+    template<typename TaskData>
+    auto await_transform(corey::Task<TaskData>&& task) {
+        return std::move(task).operator co_await();
+    }
+
+    template<typename GenData>
+    auto await_transform(corey::GeneratorNext<GenData> next) noexcept {
+        return next;
+    }
+
     auto await_transform(std::exception_ptr exp) {
+        static_cast<Self*>(this)->fail(exp);
+        return static_cast<Self*>(this)->final_suspend();
+    }
+
+    // Finishes coroutine returning Result with the error, nothing is thrown.
+    auto await_transform(std::error_code error) {
+        static_cast<Self*>(this)->return_value(error);
+        return static_cast<Self*>(this)->final_suspend();
+    }
+
+    auto await_transform(Yield) {
         struct Awaiter {
             constexpr bool await_ready() const noexcept { return false; }
             void await_suspend(std::coroutine_handle<> handle) noexcept {
-                handle.destroy();
+                corey::Reactor::instance().add_task(make_task([handle]() { handle.resume(); }));
             }
             constexpr void await_resume() noexcept {}
         };
-        if (!static_cast<Self*>(this)->_promise.has_future()) {
-            log_orphaned_exception(exp);
-        }
-        static_cast<Self*>(this)->_promise.set_exception(exp);
         return Awaiter{};
     }
 
-    auto await_transform(Yield) {
+    auto await_transform(MaybeYield) {
         struct Awaiter {
-            constexpr bool await_ready() const noexcept { return false; }
+            bool await_ready() const noexcept { return !need_preempt(); }
             void await_suspend(std::coroutine_handle<> handle) noexcept {
                 corey::Reactor::instance().add_task(make_task([handle]() { handle.resume(); }));
             }
@@ -74,7 +117,47 @@ struct BaseCoroPromise {
         };
         return Awaiter{};
     }
+};
+
+template<typename Self>
+struct BaseCoroPromise : public AwaitingPromise<Self> {
+    // Destroys finished coroutine and transfers control to the coroutine
+    // awaiting its future, so chain of awaits unwinds in a single pass
+    // without growing the stack.
+    struct FinalAwaiter {
+        constexpr bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle) noexcept {
+            // awaiter lives in the frame being destroyed
+            auto next = _next;
+            handle.destroy();
+            return next ? next : std::noop_coroutine();
+        }
+        constexpr void await_resume() const noexcept {}
+
+        std::coroutine_handle<> _next;
+    };
+
+    auto get_return_object() {
+        auto future = static_cast<Self*>(this)->_promise.get_future();
+        static_cast<Self*>(this)->_promise.hold_waiter();
+        return future;
+    }
 
+    [[nodiscard]] constexpr std::suspend_never initial_suspend() noexcept { return {}; }
+    [[nodiscard]] FinalAwaiter final_suspend() noexcept {
+        return FinalAwaiter{ static_cast<Self*>(this)->_promise.take_waiter() };
+    }
+
+    void unhandled_exception() {
+        fail(std::current_exception());
+    }
+
+    void fail(std::exception_ptr exp) {
+        if (!static_cast<Self*>(this)->_promise.has_future()) {
+            log_orphaned_exception(exp);
+        }
+        static_cast<Self*>(this)->_promise.set_exception(exp);
+    }
 };
 
 template<typename Data>
@@ -102,6 +185,281 @@ struct CoroPromise<void> : public BaseCoroPromise<CoroPromise<void>> {
     }
 };
 
+// Promise of lazy Task. Result is kept in coroutine frame, which is owned
+// by Task object, so awaiting a task needs no shared state.
+template<typename Self>
+struct BaseTaskPromise : public AwaitingPromise<Self> {
+    // Transfers control back to the coroutine awaiting the task. Frame is
+    // destroyed later by Task owning it.
+    struct FinalAwaiter {
+        constexpr bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept {
+            return _next ? _next : std::noop_coroutine();
+        }
+        constexpr void await_resume() const noexcept {}
+
+        std::coroutine_handle<> _next;
+    };
+
+    auto get_return_object() noexcept {
+        return std::coroutine_handle<Self>::from_promise(*static_cast<Self*>(this));
+    }
+
+    [[nodiscard]] constexpr std::suspend_always initial_suspend() noexcept { return {}; }
+    [[nodiscard]] FinalAwaiter final_suspend() noexcept {
+        return FinalAwaiter{ _waiter };
+    }
+
+    void unhandled_exception() noexcept {
+        fail(std::current_exception());
+    }
+
+    void fail(std::exception_ptr exp) noexcept {
+        _exception = exp;
+    }
+
+    std::coroutine_handle<> _waiter;
+    std::exception_ptr _exception;
+};
+
+template<typename Data>
+struct TaskPromise : public BaseTaskPromise<TaskPromise<Data>> {
+    std::optional<Data> _data;
+    void return_value(Data&& data) noexcept(std::is_nothrow_move_constructible_v<Data>) {
+        _data.emplace(std::move(data));
+    }
+    void return_value(const Data& data) noexcept(std::is_nothrow_copy_constructible_v<Data>) {
+        _data.emplace(data);
+    }
+    void return_value(std::exception_ptr exp) noexcept {
+        this->fail(exp);
+    }
+
+    Data result() {
+        if (this->_exception) {
+            std::rethrow_exception(this->_exception);
+        }
+        return std::move(*_data);
+    }
+};
+
+template<>
+struct TaskPromise<void> : public BaseTaskPromise<TaskPromise<void>> {
+    void return_void() noexcept {}
+
+    void result() {
+        if (this->_exception) {
+            std::rethrow_exception(this->_exception);
+        }
+    }
+};
+
+// Lazy coroutine: starts when awaited and resumes awaiting coroutine
+// directly when finished. Unlike Future, it has no heap allocated state,
+// but must be awaited by single owner. Convert it to Future to run it
+// detached.
+template<typename Data>
+class [[nodiscard]] Task {
+public:
+    using promise_type = TaskPromise<Data>;
+
+    Task(std::coroutine_handle<promise_type> handle) noexcept : _handle(handle) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    Task(Task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            this->~Task();
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task() {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            Task task;
+            constexpr bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle) noexcept {
+                task._handle.promise()._waiter = handle;
+                return task._handle;
+            }
+            Data await_resume() {
+                return task._handle.promise().result();
+            }
+        };
+        return Awaiter{ std::move(*this) };
+    }
+
+    // Starts task, result is delivered through future.
+    Future<Data> to_future() && {
+        return detach(std::move(*this));
+    }
+
+    operator Future<Data>() && {
+        return std::move(*this).to_future();
+    }
+
+private:
+    static Future<Data> detach(Task task) {
+        if constexpr (std::is_void_v<Data>) {
+            co_await std::move(task);
+        } else {
+            co_return co_await std::move(task);
+        }
+    }
+
+    std::coroutine_handle<promise_type> _handle;
+};
+
+template<typename Data>
+class AsyncGenerator;
+
+// Promise of AsyncGenerator. Yielded item stays in producer frame until
+// consumer asks for the next one, so items are never copied.
+template<typename Data>
+struct GeneratorPromise : public AwaitingPromise<GeneratorPromise<Data>> {
+    using Value = std::remove_reference_t<Data>;
+
+    // Transfers control back to the consumer, on yield and on finish.
+    struct SwitchAwaiter {
+        constexpr bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept {
+            return _next ? _next : std::noop_coroutine();
+        }
+        constexpr void await_resume() const noexcept {}
+
+        std::coroutine_handle<> _next;
+    };
+
+    AsyncGenerator<Data> get_return_object() noexcept {
+        return std::coroutine_handle<GeneratorPromise>::from_promise(*this);
+    }
+
+    [[nodiscard]] constexpr std::suspend_always initial_suspend() noexcept { return {}; }
+    [[nodiscard]] SwitchAwaiter final_suspend() noexcept {
+        _current = nullptr;
+        return SwitchAwaiter{ _waiter };
+    }
+
+    SwitchAwaiter yield_value(Value& value) noexcept {
+        _current = std::addressof(value);
+        return SwitchAwaiter{ _waiter };
+    }
+
+    SwitchAwaiter yield_value(Value&& value) noexcept {
+        _current = std::addressof(value);
+        return SwitchAwaiter{ _waiter };
+    }
+
+    void return_void() noexcept {}
+
+    using AwaitingPromise<GeneratorPromise<Data>>::await_transform;
+
+    // Rethrows inside producer, so it finishes through unhandled_exception()
+    // and final_suspend() instead of staying resumable.
+    auto await_transform(std::exception_ptr exp) noexcept {
+        struct Awaiter {
+            constexpr bool await_ready() const noexcept { return true; }
+            constexpr void await_suspend(std::coroutine_handle<>) const noexcept {}
+            [[noreturn]] void await_resume() const { std::rethrow_exception(_exp); }
+
+            std::exception_ptr _exp;
+        };
+        return Awaiter{ std::move(exp) };
+    }
+
+    void unhandled_exception() noexcept {
+        fail(std::current_exception());
+    }
+
+    void fail(std::exception_ptr exp) noexcept {
+        _exception = exp;
+    }
+
+    Value* result() {
+        if (_exception) {
+            std::rethrow_exception(std::exchange(_exception, nullptr));
+        }
+        return _current;
+    }
+
+    Value* _current = nullptr;
+    std::coroutine_handle<> _waiter;
+    std::exception_ptr _exception;
+};
+
+// Awaitable returned by AsyncGenerator::next(), resumes producer until it
+// yields next item or finishes.
+template<typename Data>
+class GeneratorNext {
+public:
+    using Handle = std::coroutine_handle<GeneratorPromise<Data>>;
+
+    explicit GeneratorNext(Handle handle) noexcept : _handle(handle) {}
+
+    bool await_ready() const noexcept { return _handle.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle) noexcept {
+        _handle.promise()._waiter = handle;
+        return _handle;
+    }
+    auto* await_resume() {
+        return _handle.promise().result();
+    }
+
+private:
+    Handle _handle;
+};
+
+// Lazy coroutine producing sequence of items with co_yield, it may await
+// futures and tasks in between. Producer runs only while consumer awaits
+// next(), so it never runs ahead of the consumer:
+//
+//     while (auto* item = co_await gen.next()) { ... }
+//
+// Item pointer is valid until next() is called again. Exception thrown by
+// producer is rethrown from next(), after which generator is finished.
+template<typename Data>
+class [[nodiscard]] AsyncGenerator {
+public:
+    using promise_type = GeneratorPromise<Data>;
+
+    AsyncGenerator(std::coroutine_handle<promise_type> handle) noexcept : _handle(handle) {}
+    AsyncGenerator(const AsyncGenerator&) = delete;
+    AsyncGenerator& operator=(const AsyncGenerator&) = delete;
+
+    AsyncGenerator(AsyncGenerator&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+
+    AsyncGenerator& operator=(AsyncGenerator&& other) noexcept {
+        if (this != &other) {
+            this->~AsyncGenerator();
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+
+    // Must not be destroyed while next() is pending.
+    ~AsyncGenerator() {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    GeneratorNext<Data> next() noexcept {
+        return GeneratorNext<Data>(_handle);
+    }
+
+private:
+    std::coroutine_handle<promise_type> _handle;
+};
+
 } // namespace corey
 
 template<typename Data, typename... Args>
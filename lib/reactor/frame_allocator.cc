@@ -0,0 +1,117 @@
+#include "reactor/frame_allocator.hh"
+
+#include <boost/core/demangle.hpp>
+
+#include <array>
+#include <deque>
+#include <new>
+#include <utility>
+
+namespace corey {
+
+namespace {
+
+constexpr std::size_t class_count = max_frame_size / frame_granularity;
+
+struct FreeFrame {
+    FreeFrame* next;
+};
+
+// Trivially destructible, so frames freed during thread teardown can still
+// find out that cache is gone.
+struct FrameCache {
+    std::array<FreeFrame*, class_count> free;
+    std::array<std::size_t, class_count> cached;
+    FrameAllocatorStats stats;
+    bool armed;
+    bool released;
+};
+
+// Owns cached frames and type stats, destroyed on thread exit.
+struct FrameRegistry {
+    std::deque<FrameTypeStats> types;
+
+    // Does nothing, but first call on a thread constructs registry.
+    void touch() noexcept {}
+
+    ~FrameRegistry();
+};
+
+thread_local FrameCache g_cache = {};
+thread_local FrameRegistry g_registry;
+
+FrameRegistry::~FrameRegistry() {
+    for (auto& head: g_cache.free) {
+        while (head) {
+            ::operator delete(std::exchange(head, head->next));
+        }
+    }
+    g_cache.cached = {};
+    g_cache.stats.cached = 0;
+    g_cache.released = true;
+}
+
+std::size_t size_class(std::size_t size) noexcept {
+    return (size - 1) / frame_granularity;
+}
+
+} // namespace
+
+void* allocate_frame(std::size_t size) {
+    auto& cache = g_cache;
+    ++cache.stats.allocations;
+    if (size > max_frame_size) {
+        ++cache.stats.large;
+        return ::operator new(size);
+    }
+    auto idx = size_class(size);
+    if (auto* frame = cache.free[idx]) {
+        cache.free[idx] = frame->next;
+        --cache.cached[idx];
+        --cache.stats.cached;
+        ++cache.stats.hits;
+        return frame;
+    }
+    return ::operator new((idx + 1) * frame_granularity);
+}
+
+void deallocate_frame(void* ptr, std::size_t size) noexcept {
+    auto& cache = g_cache;
+    if ((size > max_frame_size) || cache.released) {
+        ::operator delete(ptr);
+        return;
+    }
+    auto idx = size_class(size);
+    if (cache.cached[idx] == max_cached_frames) {
+        ::operator delete(ptr);
+        return;
+    }
+    if (!cache.armed) {
+        // registry frees cached frames on thread exit
+        g_registry.touch();
+        cache.armed = true;
+    }
+    cache.free[idx] = new (ptr) FreeFrame{ cache.free[idx] };
+    ++cache.cached[idx];
+    ++cache.stats.cached;
+}
+
+FrameTypeStats* register_frame_type(const std::type_info& type) {
+    if (g_cache.released) {
+        return nullptr;
+    }
+    return &g_registry.types.emplace_back(FrameTypeStats{ .name = boost::core::demangle(type.name()) });
+}
+
+FrameAllocatorStats frame_allocator_stats() noexcept {
+    return g_cache.stats;
+}
+
+std::vector<FrameTypeStats> frame_type_stats() {
+    if (g_cache.released) {
+        return {};
+    }
+    return { g_registry.types.begin(), g_registry.types.end() };
+}
+
+} // namespace corey
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace corey {
+
+// Coroutine frames are cached per thread, so with one reactor per thread
+// every shard reuses its own frames. Frame sizes are rounded up to size
+// classes of frame_granularity bytes, each class keeps up to
+// max_cached_frames freed frames. Larger frames go to global allocator.
+inline constexpr std::size_t frame_granularity = 64;
+inline constexpr std::size_t max_frame_size = 2048;
+inline constexpr std::size_t max_cached_frames = 256;
+
+struct FrameAllocatorStats {
+    std::uint64_t allocations = 0;
+    // allocations served from cache
+    std::uint64_t hits = 0;
+    // allocations larger than max_frame_size
+    std::uint64_t large = 0;
+    std::uint64_t cached = 0;
+
+    double hit_rate() const noexcept {
+        return allocations ? static_cast<double>(hits) / allocations : 0.0;
+    }
+};
+
+struct FrameTypeStats {
+    std::string name;
+    std::uint64_t allocations = 0;
+    std::size_t min_size = std::numeric_limits<std::size_t>::max();
+    std::size_t max_size = 0;
+};
+
+void* allocate_frame(std::size_t size);
+void deallocate_frame(void* ptr, std::size_t size) noexcept;
+
+// Returns nullptr when thread is being destroyed.
+FrameTypeStats* register_frame_type(const std::type_info&);
+
+// Same as allocate_frame, also counts frame in stats of Promise type.
+template<typename Promise>
+void* allocate_frame(std::size_t size) {
+    static thread_local FrameTypeStats* type = register_frame_type(typeid(Promise));
+    if (type) {
+        ++type->allocations;
+        type->min_size = std::min(type->min_size, size);
+        type->max_size = std::max(type->max_size, size);
+    }
+    return allocate_frame(size);
+}
+
+// Stats of calling thread.
+FrameAllocatorStats frame_allocator_stats() noexcept;
+std::vector<FrameTypeStats> frame_type_stats();
+
+} // namespace corey
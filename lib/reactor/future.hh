@@ -1,5 +1,7 @@
 #pragma once
 
+#include "reactor/reactor.hh"
+#include "reactor/task.hh"
 #include "utils/common.hh"
 
 #include <algorithm>
@@ -8,8 +10,13 @@
 #include <cstdint>
 #include <cstdlib>
 #include <exception>
+#include <functional>
+#include <optional>
 #include <stdexcept>
 #include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
 
 #include <boost/smart_ptr/intrusive_ptr.hpp>
 
@@ -106,7 +113,15 @@ public:
     State(const State<Data>&) = delete;
     State& operator=(const State<Data>&) = delete;
 
-    State(State<Data>&& other) noexcept : mode(other.mode), ref_cnt(other.ref_cnt) {
+    State(State<Data>&& other) noexcept
+        : mode(other.mode)
+        , ref_cnt(other.ref_cnt)
+        , continuation(std::move(other.continuation))
+        , waiter(std::exchange(other.waiter, nullptr))
+        , abandon(std::exchange(other.abandon, nullptr))
+        , group(other.group)
+        , waiter_held(other.waiter_held)
+        , run_inline(other.run_inline) {
         switch(mode) {
         case Mode::empty:
             break;
@@ -185,11 +200,80 @@ public:
             new(this->bytes.data()) Data(std::forward<Args>(args)...);
         }
         this->mode = Mode::data;
+        this->schedule_continuation();
     }
 
     void set_exception(std::exception_ptr ptr) {
         new(this->bytes.data()) std::exception_ptr(ptr);
         this->mode = Mode::exception;
+        this->schedule_continuation();
+    }
+
+    // Continuation is scheduled on reactor exactly once, when state becomes ready.
+    // It runs in the scheduling group that was current when it was set.
+    void set_continuation(Executable&& cont) {
+        COREY_ASSERT(!this->continuation && !this->waiter);
+        this->continuation = std::move(cont);
+        this->group = Reactor::instance().current_scheduling_group();
+        if (this->is_ready()) {
+            this->schedule_continuation();
+        }
+    }
+
+    // Continuation runs right in set() or set_exception(), so it must be
+    // short. Scheduling group is not changed.
+    void set_inline_continuation(Executable&& cont) {
+        COREY_ASSERT(!this->continuation && !this->waiter);
+        this->continuation = std::move(cont);
+        this->run_inline = true;
+        if (this->is_ready()) {
+            this->schedule_continuation();
+        }
+    }
+
+    // Coroutine waiting for the state. If state is produced by a coroutine,
+    // waiter is resumed by symmetric transfer when producer finishes,
+    // otherwise it is scheduled like any continuation.
+    void set_continuation(std::coroutine_handle<> handle) {
+        COREY_ASSERT(!this->continuation && !this->waiter);
+        this->waiter = handle;
+        this->group = Reactor::instance().current_scheduling_group();
+        if (this->is_ready()) {
+            this->schedule_continuation();
+        }
+    }
+
+    // Drops continuation that did not run yet.
+    void reset_continuation() noexcept {
+        this->continuation = Executable();
+        this->run_inline = false;
+    }
+
+    // Runs handler when state is dropped by everyone but producer before it
+    // is ready, so producer may release what it keeps for the result.
+    // Handler must outlive the state or be reset.
+    void set_abandon_handler(AbstractExecutable* handler) noexcept {
+        this->abandon = handler;
+    }
+
+    // Used by coroutine producing the state: waiter is not scheduled when
+    // state becomes ready, but is handed over by take_waiter().
+    void hold_waiter(bool held = true) noexcept {
+        this->waiter_held = held;
+    }
+
+    // Returns waiter to be resumed by symmetric transfer. Waiter from other
+    // scheduling group is scheduled as usual to keep groups isolated.
+    std::coroutine_handle<> take_waiter() {
+        this->waiter_held = false;
+        if (!this->waiter) {
+            return nullptr;
+        }
+        if (this->group != Reactor::instance().current_scheduling_group()) {
+            this->schedule_continuation();
+            return nullptr;
+        }
+        return std::exchange(this->waiter, nullptr);
     }
 
     void clear() {
@@ -204,6 +288,20 @@ public:
 
 private:
 
+    void schedule_continuation() {
+        if (this->continuation && this->run_inline) {
+            // continuation may own the last future referring to state
+            auto cont = std::move(this->continuation);
+            cont.try_execute();
+        } else if (this->continuation) {
+            Reactor::instance().add_task(std::move(this->continuation), this->group);
+        } else if (this->waiter && !this->waiter_held) {
+            Reactor::instance().add_task(make_task([handle = std::exchange(this->waiter, nullptr)] {
+                handle.resume();
+            }), this->group);
+        }
+    }
+
     ~State() {
         switch(this->mode) {
         case Mode::empty: break;
@@ -227,6 +325,9 @@ private:
         }
         if ((--ptr->ref_cnt) == 0){ 
             delete ptr;
+        } else if (ptr->abandon && ptr->ref_cnt == 1 && !ptr->is_ready()) {
+            // handler may drop the last reference, state is not touched after it
+            std::exchange(ptr->abandon, nullptr)->execute();
         }
     }
 
@@ -236,6 +337,12 @@ private:
         exception
     } mode;
     std::uint32_t ref_cnt;
+    Executable continuation;
+    std::coroutine_handle<> waiter;
+    AbstractExecutable* abandon = nullptr;
+    SchedulingGroup group;
+    bool waiter_held = false;
+    bool run_inline = false;
 
     alignas(DataExceptionEnumAlign<Data>)
     std::array<uint8_t, DataExceptionEnumSize<Data>> bytes;
@@ -246,6 +353,43 @@ requires (!std::is_reference_v<Data>)
 class Promise;
 
 template <typename Data = void>
+class Future;
+
+template <typename Data = void>
+class SharedFuture;
+
+template<typename DataFut = void, typename... Args>
+Future<DataFut> make_ready_future(Args&&... args);
+
+template<typename DataFut = void>
+Future<DataFut> make_exception_future(std::exception_ptr);
+
+template<typename Data>
+struct FutureTraits {
+    static constexpr bool is_future = false;
+    using Type = Data;
+};
+
+template<typename Data>
+struct FutureTraits<Future<Data>> {
+    static constexpr bool is_future = true;
+    using Type = Data;
+};
+
+
+template<typename Data>
+using FutureValue = std::conditional_t<std::is_void_v<Data>, std::monostate, Data>;
+
+// Future created ready keeps its result inline, only futures retrieved from
+// promise refer to heap allocated shared state.
+template<typename Data>
+using FutureStorage = std::variant<IntrusivePtr<State<Data>>, FutureValue<Data>, std::exception_ptr>;
+
+inline constexpr std::size_t future_shared = 0;
+inline constexpr std::size_t future_value = 1;
+inline constexpr std::size_t future_exception = 2;
+
+template <typename Data>
 class [[nodiscard]] Future {
     friend class Promise<Data>;
 public:
@@ -256,11 +400,11 @@ public:
     Future(const Future<Data>&) = delete;
     Future& operator=(const Future<Data>&) = delete;
 
-    Future(Future<Data>&& other) : state(std::move(other.state)) {}
+    Future(Future<Data>&& other) : storage(std::move(other.storage)) {}
 
     Future& operator=(Future<Data>&& rhs) {
-        if (this->state != rhs.state) {
-            this->state = std::move(rhs.state);
+        if (this != &rhs) {
+            this->storage = std::move(rhs.storage);
         }
         return *this;
     }
@@ -269,21 +413,154 @@ public:
 
     [[nodiscard]]
     Data get() {
-        if constexpr (std::is_void_v<Data>) {
-            this->state->get();
-        } else {
-            return std::move(this->state->get());
+        switch (this->storage.index()) {
+        case future_value:
+            if constexpr (std::is_void_v<Data>) {
+                return;
+            } else {
+                return std::move(std::get<future_value>(this->storage));
+            }
+        case future_exception:
+            std::rethrow_exception(std::get<future_exception>(this->storage));
+        default:
+            if constexpr (std::is_void_v<Data>) {
+                this->shared()->get();
+            } else {
+                return std::move(this->shared()->get());
+            }
         }
     }
 
     [[nodiscard]]
-    auto get_exception() noexcept { return this->state->get_exception(); }
+    std::exception_ptr get_exception() noexcept {
+        switch (this->storage.index()) {
+        case future_value: return {};
+        case future_exception: return std::get<future_exception>(this->storage);
+        default: return this->shared()->get_exception();
+        }
+    }
 
     [[nodiscard]]
-    bool is_ready() const noexcept { return this->state->is_ready(); }
+    bool is_ready() const noexcept {
+        return (this->storage.index() != future_shared) || this->shared()->is_ready();
+    }
 
     [[nodiscard]]
-    bool has_failed() const noexcept { return this->state->has_failed(); }
+    bool has_failed() const noexcept {
+        switch (this->storage.index()) {
+        case future_value: return false;
+        case future_exception: return true;
+        default: return this->shared()->has_failed();
+        }
+    }
+
+    void set_continuation(Executable&& cont) {
+        if (this->storage.index() == future_shared) {
+            this->shared()->set_continuation(std::move(cont));
+        } else {
+            Reactor::instance().add_task(std::move(cont));
+        }
+    }
+
+    void set_continuation(std::coroutine_handle<> handle) {
+        if (this->storage.index() == future_shared) {
+            this->shared()->set_continuation(handle);
+        } else {
+            Reactor::instance().add_task(make_task([handle] { handle.resume(); }));
+        }
+    }
+
+    // Continuation runs inline when promise is set, or right away if
+    // future is ready.
+    void set_inline_continuation(Executable&& cont) {
+        if (this->storage.index() == future_shared) {
+            this->shared()->set_inline_continuation(std::move(cont));
+        } else {
+            cont.try_execute();
+        }
+    }
+
+    // Drops continuation that did not run yet.
+    void reset_continuation() noexcept {
+        if (this->storage.index() == future_shared) {
+            this->shared()->reset_continuation();
+        }
+    }
+
+    // Calls func with result when future becomes ready. Func returning
+    // Future is unwrapped. On failure func is skipped and exception is
+    // passed on. If future is not ready yet, func runs inline when
+    // promise is set, so it should be short.
+    template<typename Func>
+    auto then(Func&& func) {
+        using Ret = typename InvokeResult<Func>::type;
+        using Result = typename FutureTraits<Ret>::Type;
+        return std::move(*this).template chain<Result>([func = std::forward<Func>(func)](Future&& fut) mutable {
+            if (fut.has_failed()) {
+                return make_exception_future<Result>(fut.get_exception());
+            }
+            if constexpr (FutureTraits<Ret>::is_future) {
+                return invoke_with(func, fut);
+            } else if constexpr (std::is_void_v<Ret>) {
+                invoke_with(func, fut);
+                return make_ready_future<>();
+            } else {
+                return make_ready_future<Result>(invoke_with(func, fut));
+            }
+        });
+    }
+
+    // Calls func with exception if future fails, func returns replacement
+    // result (or Future of it). Successful result is passed on.
+    template<typename Func>
+    Future handle_exception(Func&& func) {
+        using Ret = std::invoke_result_t<Func, std::exception_ptr>;
+        return std::move(*this).template chain<Data>([func = std::forward<Func>(func)](Future&& fut) mutable {
+            if (!fut.has_failed()) {
+                return std::move(fut);
+            }
+            if constexpr (FutureTraits<Ret>::is_future) {
+                return std::invoke(func, fut.get_exception());
+            } else if constexpr (std::is_void_v<Ret>) {
+                std::invoke(func, fut.get_exception());
+                return make_ready_future<Data>();
+            } else {
+                return make_ready_future<Data>(std::invoke(func, fut.get_exception()));
+            }
+        });
+    }
+
+    // Calls func when future becomes ready, result is passed on.
+    template<typename Func>
+    Future finally(Func&& func) {
+        return std::move(*this).template chain<Data>([func = std::forward<Func>(func)](Future&& fut) mutable {
+            std::invoke(func);
+            return std::move(fut);
+        });
+    }
+
+    // Converts future to one that can be copied and awaited many times.
+    SharedFuture<Data> share() && {
+        return SharedFuture<Data>(std::move(*this));
+    }
+
+    // Passes result to promise when future becomes ready.
+    void forward_to(Promise<Data>&& promise) && {
+        if (!this->is_ready()) {
+            auto* state = this->shared();
+            state->set_inline_continuation(make_task([fut = std::move(*this), promise = std::move(promise)]() mutable {
+                std::move(fut).forward_to(std::move(promise));
+            }));
+            return;
+        }
+        if (this->has_failed()) {
+            promise.set_exception(this->get_exception());
+        } else if constexpr (std::is_void_v<Data>) {
+            promise.set();
+        } else {
+            promise.set(this->get());
+        }
+    }
 
     template<typename DataFut, typename... Args>
     friend Future<DataFut> make_ready_future(Args&&... args);
@@ -293,10 +570,57 @@ public:
 
 private:
 
-    Future(const IntrusivePtr<State<Data>>& state) noexcept : state(state) { ; }
-    Future(IntrusivePtr<State<Data>>&& state) noexcept : state(std::move(state)) { ; }
+    template<std::size_t Index, typename... Args>
+    explicit Future(std::in_place_index_t<Index> index, Args&&... args)
+        : storage(index, std::forward<Args>(args)...) { ; }
 
-    IntrusivePtr<State<Data>> state;
+    State<Data>* shared() const noexcept {
+        return std::get<future_shared>(this->storage).get();
+    }
+
+    template<typename Func>
+    struct InvokeResult : std::invoke_result<Func, Data&&> {};
+
+    template<typename Func>
+    requires std::is_void_v<Data>
+    struct InvokeResult<Func> : std::invoke_result<Func> {};
+
+    template<typename Func>
+    static decltype(auto) invoke_with(Func& func, Future& fut) {
+        if constexpr (std::is_void_v<Data>) {
+            fut.get();
+            return std::invoke(func);
+        } else {
+            return std::invoke(func, fut.get());
+        }
+    }
+
+    // Func maps ready future to Future<Result>, exception thrown by func
+    // fails resulting future.
+    template<typename Result, typename Func>
+    Future<Result> chain(Func&& func) && {
+        auto call = [](Func& func, Future&& fut) noexcept {
+            try {
+                return std::invoke(func, std::move(fut));
+            } catch (...) {
+                return make_exception_future<Result>(std::current_exception());
+            }
+        };
+        if (this->is_ready()) {
+            return call(func, std::move(*this));
+        }
+        Promise<Result> promise;
+        auto result = promise.get_future();
+        auto* state = this->shared();
+        state->set_inline_continuation(make_task(
+            [fut = std::move(*this), promise = std::move(promise), func = std::forward<Func>(func), call]() mutable {
+                call(func, std::move(fut)).forward_to(std::move(promise));
+            }
+        ));
+        return result;
+    }
+
+    FutureStorage<Data> storage;
 };
 
 template <typename Data>
@@ -323,6 +647,8 @@ public:
 
     ~Promise() {
         if ((this->state) && (this->state->get_ref_cnt() > 1) && (!this->state->is_ready())) {
+            // coroutine destroyed before finishing can't hand over its waiter
+            this->state->hold_waiter(false);
             set_exception(std::make_exception_ptr(BrokenPromise()));
         }
     }
@@ -339,7 +665,14 @@ public:
         if (this->state->get_ref_cnt() > 1) {
             throw FutureAlreadyRetrived();
         }
-        return FutureType(this->state);
+        return FutureType(std::in_place_index<future_shared>, this->state);
+    }
+
+    // Shared future can be copied to any number of waiters, but as with
+    // get_future() it is retrieved once.
+    [[nodiscard]]
+    SharedFuture<Data> get_shared_future() {
+        return SharedFuture<Data>(get_future());
     }
 
     template<typename... Args>
@@ -371,18 +704,133 @@ public:
     template<typename Arg>
     void set_exception(Arg&& arg) = delete;
 
+    // See State::set_abandon_handler(), future must be retrieved already.
+    void set_abandon_handler(AbstractExecutable* handler) noexcept {
+        this->state->set_abandon_handler(handler);
+    }
+
+    // Coroutine promise support, see State::hold_waiter().
+    void hold_waiter() { this->state->hold_waiter(); }
+    std::coroutine_handle<> take_waiter() { return this->state->take_waiter(); }
+
 private:
     IntrusivePtr<State<Data>> state;
 };
 
-template<typename DataFut = void, typename... Args>
+// Result of future shared by many waiters. Value is stored once and handed
+// out by const reference, which stays valid while any copy of shared future
+// exists. Awaiting coroutines are all scheduled in one pass when result is set.
+template <typename Data>
+class SharedFuture {
+public:
+
+    explicit SharedFuture(Future<Data>&& source) : state(new SharedState()) {
+        if (source.is_ready()) {
+            this->state->take(source);
+            return;
+        }
+        // continuation does not own shared state, otherwise unfulfilled
+        // source would keep it alive; state detaches it when destroyed
+        this->state->source.emplace(std::move(source));
+        this->state->source->set_inline_continuation(make_task([state = this->state.get()] {
+            state->resolve();
+        }));
+    }
+
+    [[nodiscard]]
+    bool is_ready() const noexcept { return this->state->result.index() != 0; }
+
+    [[nodiscard]]
+    bool has_failed() const noexcept { return this->state->result.index() == 2; }
+
+    [[nodiscard]]
+    std::exception_ptr get_exception() const noexcept {
+        switch (this->state->result.index()) {
+        case 0: return std::make_exception_ptr(FutureNotReady());
+        case 1: return {};
+        default: return std::get<2>(this->state->result);
+        }
+    }
+
+    [[nodiscard]]
+    decltype(auto) get() const {
+        switch (this->state->result.index()) {
+        case 0:
+            throw FutureNotReady();
+        case 2:
+            std::rethrow_exception(std::get<2>(this->state->result));
+        default:
+            if constexpr (std::is_void_v<Data>) {
+                return;
+            } else {
+                return static_cast<const Data&>(std::get<1>(this->state->result));
+            }
+        }
+    }
+
+    // Coroutine is resumed in scheduling group current at the time of call.
+    void add_waiter(std::coroutine_handle<> handle) {
+        auto group = Reactor::instance().current_scheduling_group();
+        if (this->is_ready()) {
+            Reactor::instance().add_task(make_task([handle] { handle.resume(); }), group);
+            return;
+        }
+        this->state->waiters.emplace_back(handle, group);
+    }
+
+private:
+
+    struct SharedState {
+        std::variant<std::monostate, FutureValue<Data>, std::exception_ptr> result;
+        std::optional<Future<Data>> source;
+        std::vector<std::pair<std::coroutine_handle<>, SchedulingGroup>> waiters;
+        std::uint32_t ref_cnt = 0;
+
+        ~SharedState() {
+            if (this->source) {
+                this->source->reset_continuation();
+            }
+        }
+
+        void take(Future<Data>& fut) {
+            if (fut.has_failed()) {
+                this->result.template emplace<2>(fut.get_exception());
+            } else if constexpr (std::is_void_v<Data>) {
+                this->result.template emplace<1>();
+            } else {
+                this->result.template emplace<1>(fut.get());
+            }
+        }
+
+        void resolve() {
+            this->take(*this->source);
+            this->source.reset();
+            for (auto [handle, group]: std::exchange(this->waiters, {})) {
+                Reactor::instance().add_task(make_task([handle] { handle.resume(); }), group);
+            }
+        }
+
+        friend void intrusive_ptr_add_ref(SharedState* ptr) noexcept {
+            ++ptr->ref_cnt;
+        }
+        friend void intrusive_ptr_release(SharedState* ptr) noexcept {
+            if ((--ptr->ref_cnt) == 0) {
+                delete ptr;
+            }
+        }
+    };
+
+    IntrusivePtr<SharedState> state;
+};
+
+template<typename DataFut, typename... Args>
 Future<DataFut> make_ready_future(Args&&... args) {
-    return Future<DataFut>(IntrusivePtr<State<DataFut>>(new State<DataFut>(std::forward<Args>(args)...)));
+    return Future<DataFut>(std::in_place_index<future_value>, std::forward<Args>(args)...);
 }
 
-template<typename DataFut = void>
+template<typename DataFut>
 Future<DataFut> make_exception_future(std::exception_ptr exc) {
-    return Future<DataFut>(IntrusivePtr<State<DataFut>>(new State<DataFut>(std::move(exc))));
+    return Future<DataFut>(std::in_place_index<future_exception>, std::move(exc));
 }
 
 } // namespace gdc
@@ -2,12 +2,20 @@
 
 #include "reactor/coroutine.hh"
 
+#include <cerrno>
 #include <cstdint>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
 
 namespace corey {
 
 namespace {
 
+std::error_code io_error(int ret) noexcept {
+    return std::error_code(-ret, std::system_category());
+}
+
 } // namespace
 
 Future<File> File::open(const char* path, int flags) {
@@ -15,11 +23,25 @@ Future<File> File::open(const char* path, int flags) {
 }
 
 Future<File> File::open(const char* path, int flags, mode_t mode) {
-    auto fd = co_await IoEngine::instance().open(path, flags, mode);
-    if (fd < 0) {
-        co_await std::make_exception_ptr(std::system_error(-fd, std::system_category(), "open failed"));
-    }
-    co_return File(fd);
+    return IoEngine::instance().open(path, flags, mode).then([](int fd) {
+        if (fd < 0) {
+            throw std::system_error(-fd, std::system_category(), "open failed");
+        }
+        return File(fd);
+    });
+}
+
+Future<Result<File>> File::try_open(const char* path, int flags) {
+    return try_open(path, flags, 0);
+}
+
+Future<Result<File>> File::try_open(const char* path, int flags, mode_t mode) {
+    return IoEngine::instance().open(path, flags, mode).then([](int fd) -> Result<File> {
+        if (fd < 0) {
+            return io_error(fd);
+        }
+        return File(fd);
+    });
 }
 
 File::File() noexcept : File(invalid_fd) { }
@@ -43,30 +65,30 @@ File::~File() {
     }
 }
 
-Future<> File::fsync() const {
-    auto ret = co_await IoEngine::instance().fsync(_fd);
+Task<> File::fsync(AbortSource* abort) const {
+    auto ret = co_await IoEngine::instance().fsync(_fd, abort);
     if (ret < 0) {
         co_await std::make_exception_ptr(std::system_error(-ret, std::system_category(), "fsync failed"));
     }
 }
 
-Future<> File::fdatasync() const {
-    auto ret = co_await IoEngine::instance().fdatasync(_fd);
+Task<> File::fdatasync(AbortSource* abort) const {
+    auto ret = co_await IoEngine::instance().fdatasync(_fd, abort);
     if (ret < 0) {
         co_await std::make_exception_ptr(std::system_error(-ret, std::system_category(), "fdatasync failed"));
     }
 }
 
-Future<uint64_t> File::read(uint64_t offset, std::span<char> data) const {
-    auto result = co_await IoEngine::instance().read(_fd, offset, data);
+Task<uint64_t> File::read(uint64_t offset, std::span<char> data, AbortSource* abort) const {
+    auto result = co_await IoEngine::instance().read(_fd, offset, data, abort);
     if (result < 0) {
         co_await std::make_exception_ptr(std::system_error(-result, std::system_category(), "read failed"));
     }
     co_return static_cast<uint64_t>(result);
 }
 
-Future<uint64_t> File::write(uint64_t offset, std::span<const char> data) const {
-    auto result = co_await IoEngine::instance().write(_fd, offset, data);
+Task<uint64_t> File::write(uint64_t offset, std::span<const char> data, AbortSource* abort) const {
+    auto result = co_await IoEngine::instance().write(_fd, offset, data, abort);
     if (result < 0) {
         co_await std::make_exception_ptr(std::system_error(-result, std::system_category(), "write failed"));
     }
@@ -75,13 +97,57 @@ Future<uint64_t> File::write(uint64_t offset, std::span<const char> data) const
 
 Future<> File::close() {
     if (_fd == -1) {
-        co_await std::make_exception_ptr(std::runtime_error("File already closed"));
+        return make_exception_future<>(std::make_exception_ptr(std::runtime_error("File already closed")));
     }
-    auto result = co_await IoEngine::instance().close(_fd);
-    _fd = -1;
+    return IoEngine::instance().close(std::exchange(_fd, -1)).then([](int result) {
+        if (result < 0) {
+            throw std::system_error(-result, std::system_category(), "close failed");
+        }
+    });
+}
+
+Task<Result<>> File::try_fsync(AbortSource* abort) const {
+    auto ret = co_await IoEngine::instance().fsync(_fd, abort);
+    if (ret < 0) {
+        co_await io_error(ret);
+    }
+    co_return Result<>();
+}
+
+Task<Result<>> File::try_fdatasync(AbortSource* abort) const {
+    auto ret = co_await IoEngine::instance().fdatasync(_fd, abort);
+    if (ret < 0) {
+        co_await io_error(ret);
+    }
+    co_return Result<>();
+}
+
+Task<Result<uint64_t>> File::try_read(uint64_t offset, std::span<char> data, AbortSource* abort) const {
+    auto result = co_await IoEngine::instance().read(_fd, offset, data, abort);
     if (result < 0) {
-        co_await std::make_exception_ptr(std::system_error(-result, std::system_category(), "close failed"));
+        co_await io_error(result);
+    }
+    co_return static_cast<uint64_t>(result);
+}
+
+Task<Result<uint64_t>> File::try_write(uint64_t offset, std::span<const char> data, AbortSource* abort) const {
+    auto result = co_await IoEngine::instance().write(_fd, offset, data, abort);
+    if (result < 0) {
+        co_await io_error(result);
+    }
+    co_return static_cast<uint64_t>(result);
+}
+
+Future<Result<>> File::try_close() {
+    if (_fd == -1) {
+        return make_ready_future<Result<>>(io_error(-EBADF));
     }
+    return IoEngine::instance().close(std::exchange(_fd, -1)).then([](int ret) -> Result<> {
+        if (ret < 0) {
+            return io_error(ret);
+        }
+        return {};
+    });
 }
 
 } // namespace corey
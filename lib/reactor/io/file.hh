@@ -1,4 +1,6 @@
 #include "io.hh"
+#include "reactor/coroutine.hh"
+#include "utils/result.hh"
 
 namespace corey {
 
@@ -7,6 +9,8 @@ public:
 
     static Future<File> open(const char* path, int flags);
     static Future<File> open(const char* path, int flags, mode_t mode);
+    static Future<Result<File>> try_open(const char* path, int flags);
+    static Future<Result<File>> try_open(const char* path, int flags, mode_t mode);
 
     File() noexcept;
     File(const File& other) = delete;
@@ -15,12 +19,19 @@ public:
     File& operator=(File&& other) noexcept;
     ~File();
 
-    Future<> fsync() const;
-    Future<> fdatasync() const;
-    Future<uint64_t> read(uint64_t offset, std::span<char>) const;
-    Future<uint64_t> write(uint64_t offset, std::span<const char>) const;
+    Task<> fsync(AbortSource* abort = nullptr) const;
+    Task<> fdatasync(AbortSource* abort = nullptr) const;
+    Task<uint64_t> read(uint64_t offset, std::span<char>, AbortSource* abort = nullptr) const;
+    Task<uint64_t> write(uint64_t offset, std::span<const char>, AbortSource* abort = nullptr) const;
     Future<> close();
 
+    // Same as above, but errors are returned as values instead of thrown.
+    Task<Result<>> try_fsync(AbortSource* abort = nullptr) const;
+    Task<Result<>> try_fdatasync(AbortSource* abort = nullptr) const;
+    Task<Result<uint64_t>> try_read(uint64_t offset, std::span<char>, AbortSource* abort = nullptr) const;
+    Task<Result<uint64_t>> try_write(uint64_t offset, std::span<const char>, AbortSource* abort = nullptr) const;
+    Future<Result<>> try_close();
+
 private:
     File(int fd);
 
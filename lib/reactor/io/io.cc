@@ -14,6 +14,7 @@
 
 #include <exception>
 #include <fcntl.h>
+#include <stdexcept>
 #include <system_error>
 #include <span>
 #include <utility>
@@ -32,10 +33,79 @@ static_assert(
     "Promise<int> must be the same size as io_uring data"
 );
 
-IoEngine* _instance = nullptr;
+// user_data of internal wakeup read, never a valid Promise<int> state pointer
+constexpr __u64 wakeup_tag = ~__u64(0);
+// user_data of cancel requests, their completions are ignored
+constexpr __u64 cancel_tag = wakeup_tag - 1;
+
+// internal requests have no promise behind their user_data
+bool is_internal(__u64 user_data) noexcept {
+    return user_data == wakeup_tag || user_data == cancel_tag;
+}
+// marks user_data of linked timeouts, the rest is pointer to their timespec;
+// promise state pointers are aligned, so the bit is never set for them
+constexpr __u64 link_timeout_bit = 1;
+
+// ring size limits of kernel, larger sizes are rejected with EINVAL
+constexpr unsigned max_sq_entries = 32768;
+constexpr unsigned max_cq_entries = 2 * max_sq_entries;
+
+thread_local IoEngine* _instance = nullptr;
+
+// Releases promise into user_data, it is restored by IoEngine::complete.
+__u64 to_user_data(Promise<int>&& promise) noexcept {
+    __u64 user_data;
+    new (reinterpret_cast<void*>(&user_data)) Promise<int>(std::move(promise));
+    return user_data;
+}
+
+__kernel_timespec* make_timespec(Deadline deadline) {
+    auto since_epoch = deadline.time_since_epoch();
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+    return new __kernel_timespec{
+        .tv_sec = secs.count(),
+        .tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch - secs).count()
+    };
+}
 
 } // namespace
 
+class IoEngine::EnginePoller final : public Poller {
+public:
+    explicit EnginePoller(IoEngine& engine) noexcept : _engine(engine) {}
+
+    bool poll() override {
+        if (!_engine._wakeup_armed) {
+            _engine.arm_wakeup();
+        }
+        _engine.flush_overflow();
+        _engine.submit_pending();
+        return _engine.complete_ready();
+    }
+
+    bool pure_poll() override {
+        return io_uring_cq_ready(&_engine._ring) > 0 || _engine.has_task_work();
+    }
+
+    // Engine sleeps in io_uring_wait_cqe, so everything it needs is to have
+    // requests submitted and wakeup read armed for other threads.
+    bool try_enter_interrupt_mode() override {
+        if (!_engine._wakeup_armed) {
+            _engine.arm_wakeup();
+        }
+        _engine.flush_overflow();
+        _engine.submit_pending();
+        // SQ thread frees submission queue entries asynchronously, requests
+        // left in overflow queue must not wait for unrelated completion
+        return _engine._overflow.empty() && !pure_poll();
+    }
+
+    void exit_interrupt_mode() override {}
+
+private:
+    IoEngine& _engine;
+};
+
 IoEngine& IoEngine::instance() {
     if (!_instance) {
         panic("IoEngine not initialized");
@@ -43,27 +113,151 @@ IoEngine& IoEngine::instance() {
     return *_instance;
 }
 
-IoEngine::IoEngine(Reactor& reactor) : _reactor(reactor) {
+IoEngine::IoEngine(Reactor& reactor, const IoEngineConfig& config) : _reactor(reactor) {
     if (_instance) {
         panic("IoEngine already initialized");
     }
 
-    if (int ret = io_uring_queue_init(max_events, &_ring, 0); ret != 0) {
-        throw std::system_error(-ret, std::system_category(), "io_uring_queue_init failed");
+    setup_ring(config);
+    _wakeup_fd = eventfd(0, EFD_CLOEXEC);
+    if (_wakeup_fd < 0) {
+        auto err = errno;
+        io_uring_queue_exit(&_ring);
+        throw std::system_error(err, std::system_category(), "eventfd failed");
     }
-    _poll_routine = reactor.add_routine(make_routine([this] {
-        submit_pending();
-        complete_ready();
-    }));
+    _poller = reactor.add_poller(std::make_unique<EnginePoller>(*this));
+    _sleeper = reactor.set_sleeper([this] {
+        // without wakeup read other shards could not interrupt the wait
+        COREY_ASSERT(_wakeup_armed);
+        wait();
+    });
     _instance = this;
 }
 
 IoEngine::~IoEngine() {
+    // never submitted requests fail with BrokenPromise
+    for (auto& req : _overflow) {
+        if (req.cancelled) {
+            continue;
+        }
+        delete req.timeout;
+        if (!is_internal(req.user_data)) {
+            reinterpret_cast<Promise<int>*>(&req.user_data)->~Promise();
+        }
+    }
+    _overflow.clear();
+    _overflow_index.clear();
+
+    // Kernel does not complete requests on queue exit, so in-flight ones
+    // are cancelled and reaped: their promises get -ECANCELED and linked
+    // timespecs are freed.
+    bool cancel = _pending > 0 || _inflight > 0;
+    while (cancel || _inflight > 0) {
+        if (cancel && reserve_sqes(1)) {
+            auto sqe = io_uring_get_sqe(&_ring);
+            io_uring_prep_cancel64(sqe, 0, IORING_ASYNC_CANCEL_ANY);
+            sqe->user_data = cancel_tag;
+            ++_pending;
+            cancel = false;
+        }
+        submit_pending();
+        if (_inflight > 0) {
+            wait();
+            complete_ready();
+        }
+        // requests issued by inline continuations are cancelled as well
+        cancel = cancel || _pending > 0;
+    }
     COREY_ASSERT(_pending == 0);
     io_uring_queue_exit(&_ring);
+    ::close(_wakeup_fd);
     _instance = nullptr;
 }
 
+void IoEngine::setup_ring(const IoEngineConfig& config) {
+    // invalid sizes are rejected here, so EINVAL from kernel below means
+    // that some setup flag is not supported
+    if (config.sq_entries == 0 || config.sq_entries > max_sq_entries) {
+        throw std::invalid_argument(fmt::format("io_uring sq_entries must be in [1, {}]", max_sq_entries));
+    }
+    if (config.cq_entries && (config.cq_entries < config.sq_entries || config.cq_entries > max_cq_entries)) {
+        throw std::invalid_argument(fmt::format(
+            "io_uring cq_entries must be in [sq_entries, {}]", max_cq_entries));
+    }
+    unsigned flags = 0;
+    if (config.cq_entries) {
+        flags |= IORING_SETUP_CQSIZE;
+    }
+    if (config.single_issuer || config.defer_taskrun) {
+        flags |= IORING_SETUP_SINGLE_ISSUER;
+    }
+    // kernel rejects task work notification flags with SQ thread
+    if (config.sq_poll) {
+        flags |= IORING_SETUP_SQPOLL;
+        if (config.sq_thread_cpu) {
+            flags |= IORING_SETUP_SQ_AFF;
+        }
+    } else {
+        // task work flag lets poller see pending completions without a syscall
+        if (config.defer_taskrun) {
+            flags |= IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+        }
+        if (config.coop_taskrun) {
+            flags |= IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+        }
+    }
+    if (config.submit_all) {
+        flags |= IORING_SETUP_SUBMIT_ALL;
+    }
+
+    auto init = [this, &config](unsigned flags) {
+        io_uring_params params{};
+        params.flags = flags;
+        params.cq_entries = config.cq_entries;
+        params.sq_thread_idle = config.sq_thread_idle.count();
+        params.sq_thread_cpu = config.sq_thread_cpu.value_or(0);
+        return io_uring_queue_init_params(config.sq_entries, &_ring, &params);
+    };
+    // dropped in this order while kernel rejects setup, SQ thread may be
+    // also refused for lack of privileges
+    constexpr unsigned optional_flags[] = {
+        IORING_SETUP_SQPOLL | IORING_SETUP_SQ_AFF,
+        IORING_SETUP_DEFER_TASKRUN,
+        IORING_SETUP_SINGLE_ISSUER,
+        IORING_SETUP_COOP_TASKRUN,
+        IORING_SETUP_SUBMIT_ALL,
+    };
+    auto ret = init(flags);
+    for (auto flag : optional_flags) {
+        if (ret != -EINVAL && !(ret == -EPERM && (flags & IORING_SETUP_SQPOLL))) {
+            break;
+        }
+        if (flags & flag) {
+            logger.warn("io_uring setup flag {:#x} is not supported by kernel, dropped", flag);
+            flags &= ~flag;
+            if (!(flags & (IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_COOP_TASKRUN))) {
+                flags &= ~IORING_SETUP_TASKRUN_FLAG;
+            }
+            ret = init(flags);
+        }
+    }
+    if (ret != 0) {
+        throw std::system_error(-ret, std::system_category(), "io_uring_queue_init failed");
+    }
+}
+
+bool IoEngine::sq_needs_wakeup() const noexcept {
+    return (_ring.flags & IORING_SETUP_SQPOLL)
+        && (__atomic_load_n(_ring.sq.kflags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP);
+}
+
+bool IoEngine::has_task_work() const noexcept {
+    // with IORING_SETUP_DEFER_TASKRUN completions are posted only after
+    // engine enters kernel, peeking CQ ring does so when this flag is set
+    return (_ring.flags & IORING_SETUP_TASKRUN_FLAG)
+        && (__atomic_load_n(_ring.sq.kflags, __ATOMIC_RELAXED) & IORING_SQ_TASKRUN);
+}
+
 Future<int> IoEngine::open(const char* path, int flags) {
     if ((flags & O_CREAT) || (flags & O_TMPFILE)) {
         return make_exception_future<int>(std::make_exception_ptr(std::invalid_argument("missing mode for open")));
@@ -72,59 +266,59 @@ Future<int> IoEngine::open(const char* path, int flags) {
 }
 
 Future<int> IoEngine::open(const char* path, int flags, mode_t mode) {
-    return prepare(io_uring_prep_openat, AT_FDCWD, path, flags, mode)->get_future();
+    return request(nullptr, no_deadline, io_uring_prep_openat, AT_FDCWD, path, flags, mode);
 }
 
-Future<int> IoEngine::fsync(int fd) {
-    return prepare(io_uring_prep_fsync, fd, 0)->get_future();
+Future<int> IoEngine::fsync(int fd, AbortSource* abort, Deadline deadline) {
+    return request(abort, deadline, io_uring_prep_fsync, fd, 0);
 }
 
-Future<int> IoEngine::fdatasync(int fd) {
-    return prepare(io_uring_prep_fsync, fd, IORING_FSYNC_DATASYNC)->get_future();
+Future<int> IoEngine::fdatasync(int fd, AbortSource* abort, Deadline deadline) {
+    return request(abort, deadline, io_uring_prep_fsync, fd, IORING_FSYNC_DATASYNC);
 }
 
-Future<int> IoEngine::read(int fd, uint64_t offset, std::span<char> data) {
-    return prepare(io_uring_prep_read, fd, data.data(), data.size(), offset)->get_future();
+Future<int> IoEngine::read(int fd, uint64_t offset, std::span<char> data, AbortSource* abort, Deadline deadline) {
+    return request(abort, deadline, io_uring_prep_read, fd, data.data(), data.size(), offset);
 }
 
-Future<int> IoEngine::readv(int fd, uint64_t offset, std::span<iovec> iov) {
-    return prepare(io_uring_prep_readv, fd, iov.data(), iov.size(), offset)->get_future();
+Future<int> IoEngine::readv(int fd, uint64_t offset, std::span<iovec> iov, AbortSource* abort, Deadline deadline) {
+    return request(abort, deadline, io_uring_prep_readv, fd, iov.data(), iov.size(), offset);
 }
 
-Future<int> IoEngine::writev(int fd, uint64_t offset, std::span<const iovec> iov) {
-    return prepare(io_uring_prep_writev, fd, iov.data(), iov.size(), offset)->get_future();
+Future<int> IoEngine::writev(int fd, uint64_t offset, std::span<const iovec> iov, AbortSource* abort, Deadline deadline) {
+    return request(abort, deadline, io_uring_prep_writev, fd, iov.data(), iov.size(), offset);
 }
 
-Future<int> IoEngine::write(int fd, uint64_t offset, std::span<const char> data) {
-    return prepare(io_uring_prep_write, fd, data.data(), data.size(), offset)->get_future();
+Future<int> IoEngine::write(int fd, uint64_t offset, std::span<const char> data, AbortSource* abort, Deadline deadline) {
+    return request(abort, deadline, io_uring_prep_write, fd, data.data(), data.size(), offset);
 }
 
-Future<int> IoEngine::send(int fd, std::span<const char> buf, int flags) {
-    return prepare(io_uring_prep_send, fd, buf.data(), buf.size_bytes(), flags)->get_future();
+Future<int> IoEngine::send(int fd, std::span<const char> buf, int flags, AbortSource* abort, Deadline deadline) {
+    return request(abort, deadline, io_uring_prep_send, fd, buf.data(), buf.size_bytes(), flags);
 }
 
-Future<int> IoEngine::recv(int fd, std::span<char> buf, int flags) {
-    return prepare(io_uring_prep_recv, fd, buf.data(), buf.size_bytes(), flags)->get_future();
+Future<int> IoEngine::recv(int fd, std::span<char> buf, int flags, AbortSource* abort, Deadline deadline) {
+    return request(abort, deadline, io_uring_prep_recv, fd, buf.data(), buf.size_bytes(), flags);
 }
 
 Future<int> IoEngine::close(int fd) {
-    return prepare(io_uring_prep_close, fd)->get_future();
+    return request(nullptr, no_deadline, io_uring_prep_close, fd);
 }
 
-Future<int> IoEngine::timeout(__kernel_timespec* ts) {
-    return prepare(io_uring_prep_timeout, ts, 0, IORING_TIMEOUT_ABS)->get_future();
+Future<int> IoEngine::timeout(__kernel_timespec* ts, AbortSource* abort) {
+    return request(abort, no_deadline, io_uring_prep_timeout, ts, 0, IORING_TIMEOUT_ABS);
 }
 
 Future<int> IoEngine::socket(int domain, int type, int protocol) {
-    return prepare(io_uring_prep_socket, domain, type, protocol, 0)->get_future();
+    return request(nullptr, no_deadline, io_uring_prep_socket, domain, type, protocol, 0);
 }
 
-Future<int> IoEngine::connect(int fd, const sockaddr* addr, socklen_t addrlen) {
-    return prepare(io_uring_prep_connect, fd, addr, addrlen)->get_future();
+Future<int> IoEngine::connect(int fd, const sockaddr* addr, socklen_t addrlen, AbortSource* abort, Deadline deadline) {
+    return request(abort, deadline, io_uring_prep_connect, fd, addr, addrlen);
 }
 
-Future<int> IoEngine::accept(int fd, sockaddr* addr, socklen_t* addrlen) {
-    return prepare(io_uring_prep_accept, fd, addr, addrlen, 0)->get_future();
+Future<int> IoEngine::accept(int fd, sockaddr* addr, socklen_t* addrlen, AbortSource* abort, Deadline deadline) {
+    return request(abort, deadline, io_uring_prep_accept, fd, addr, addrlen, 0);
 }
 
 Future<int> IoEngine::setsockopt(int fd, int level, int optname, const void* optval, socklen_t optlen) {
@@ -139,34 +333,61 @@ Future<int> IoEngine::listen(int fd, int backlog) {
     return posix_call(::listen, fd, backlog);
 }
 
+void IoEngine::arm_wakeup() {
+    // overflowed read keeps engine out of interrupt mode until it is submitted
+    enqueue(wakeup_tag, nullptr, io_uring_prep_read, _wakeup_fd, &_wakeup_value, sizeof(_wakeup_value), 0);
+    _wakeup_armed = true;
+}
+
 void IoEngine::submit_pending() {
+    const bool sq_poll = _ring.flags & IORING_SETUP_SQPOLL;
     while(_pending > 0) {
+        // with SQ thread requests are handed over by moving SQ tail,
+        // io_uring_submit enters kernel only to wake up thread which went idle
+        if (!sq_poll || sq_needs_wakeup()) {
+            ++_stats.submit_syscalls;
+        }
         int ret = io_uring_submit(&_ring);
+        if (ret == -EBUSY || ret == -EAGAIN) {
+            // completion queue overflows, submitted again once completions are reaped
+            return;
+        }
         if (ret < 0) {
             logger.error("io_uring_submit failed: {}", std::system_error(-ret, std::system_category()));
             return;
         }
-        _pending -= ret;
-        _inflight += ret;
+        if (sq_poll) {
+            // SQ thread takes all entries, ret also counts ones it did not consume yet
+            _inflight += _pending;
+            _pending = 0;
+        } else {
+            _pending -= ret;
+            _inflight += ret;
+        }
     }
 }
 
-void IoEngine::complete_ready() {
+bool IoEngine::complete_ready() {
     constexpr auto complete_cqe = [](IoEngine& engine, io_uring_cqe* cqe) {
-        auto comp = reinterpret_cast<Promise<int>*>(&cqe->user_data);
-        comp->set(cqe->res);
-        comp->~Promise();
+        if (cqe->user_data == wakeup_tag) {
+            engine._wakeup_armed = false;
+        } else if (cqe->user_data == cancel_tag) {
+            // result of cancel is reported by cancelled request
+        } else if (cqe->user_data & link_timeout_bit) {
+            delete reinterpret_cast<__kernel_timespec*>(cqe->user_data & ~link_timeout_bit);
+        } else {
+            engine.complete(cqe->user_data, cqe->res);
+        }
         io_uring_cqe_seen(&engine._ring, cqe);
         --engine._inflight;
     };
 
+    bool completed = false;
     io_uring_cqe *cqe;
-    if (!_reactor.has_progress() && (_inflight > 0)) {
-        auto err = io_uring_wait_cqe(&_ring, &cqe);
-        COREY_ASSERT_MSG(err == 0, "io_uring_wait_cqe failed: {}", std::system_error(-err, std::system_category()));
-        complete_cqe(*this, cqe);
+    if (has_task_work()) {
+        // peek enters kernel to run deferred task work
+        ++_stats.wait_syscalls;
     }
-
     while (true) {
         auto err = io_uring_peek_cqe(&_ring, &cqe);
         if (err == -EAGAIN) {
@@ -174,18 +395,118 @@ void IoEngine::complete_ready() {
         }
         COREY_ASSERT_MSG(err == 0, "io_uring_peek_cqe failed: {}", std::system_error(-err, std::system_category()));
         complete_cqe(*this, cqe);
+        completed = true;
+    }
+    return completed;
+}
+
+void IoEngine::wait() {
+    ++_stats.wait_syscalls;
+    io_uring_cqe *cqe;
+    auto err = io_uring_wait_cqe(&_ring, &cqe);
+    // Interrupted by a signal (e.g. stall detector), reactor polls again.
+    if (err != -EINTR) {
+        COREY_ASSERT_MSG(err == 0, "io_uring_wait_cqe failed: {}", std::system_error(-err, std::system_category()));
+    }
+}
+
+void IoEngine::complete(__u64 user_data, int result) {
+    if (!_abortable.empty()) {
+        _abortable.erase(user_data);
+    }
+    auto comp = reinterpret_cast<Promise<int>*>(&user_data);
+    comp->set(result);
+    comp->~Promise();
+}
+
+bool IoEngine::reserve_sqes(unsigned count) {
+    if (io_uring_sq_space_left(&_ring) < count) {
+        submit_pending();
+    }
+    return io_uring_sq_space_left(&_ring) >= count;
+}
+
+void IoEngine::commit_sqe(io_uring_sqe* sqe, __u64 user_data, __kernel_timespec* timeout) {
+    sqe->user_data = user_data;
+    ++_pending;
+    if (timeout) {
+        // request and its timeout are adjacent in submission queue, kernel
+        // may read timespec after submit, it lives until timeout completes
+        sqe->flags |= IOSQE_IO_LINK;
+        auto link = io_uring_get_sqe(&_ring);
+        io_uring_prep_link_timeout(link, timeout, IORING_TIMEOUT_ABS);
+        link->user_data = reinterpret_cast<__u64>(timeout) | link_timeout_bit;
+        ++_pending;
+    }
+}
+
+void IoEngine::flush_overflow() {
+    while (!_overflow.empty()) {
+        auto& req = _overflow.front();
+        if (req.cancelled) {
+            _overflow.pop_front();
+            continue;
+        }
+        if (!reserve_sqes(req.timeout ? 2 : 1)) {
+            return;
+        }
+        auto sqe = io_uring_get_sqe(&_ring);
+        req.prep(sqe);
+        commit_sqe(sqe, req.user_data, req.timeout);
+        _overflow_index.erase(req.user_data);
+        _overflow.pop_front();
     }
 }
 
 template<typename Func, typename... Args>
-inline Promise<int>* IoEngine::prepare(Func&& func, Args&&... args) {
-    if (auto sqe = io_uring_get_sqe(&_ring)) {
+inline void IoEngine::enqueue(__u64 user_data, __kernel_timespec* timeout, Func&& func, Args&&... args) {
+    // requests keep their order, so new ones wait behind overflowed ones
+    if (_overflow.empty() && reserve_sqes(timeout ? 2 : 1)) {
+        auto sqe = io_uring_get_sqe(&_ring);
         std::invoke(std::forward<Func>(func), sqe, std::forward<Args>(args)...);
-        auto comp = new (reinterpret_cast<void*>(&sqe->user_data)) Promise<int>;
-        ++_pending;
-        return comp;
+        commit_sqe(sqe, user_data, timeout);
+        return;
+    }
+    auto& req = _overflow.emplace_back(Overflow{
+        .prep = [func, ...args = std::forward<Args>(args)](io_uring_sqe* sqe) { std::invoke(func, sqe, args...); },
+        .user_data = user_data,
+        .timeout = timeout
+    });
+    if (!is_internal(user_data)) {
+        _overflow_index.emplace(user_data, &req);
+    }
+}
+
+void IoEngine::cancel(__u64 user_data) {
+    if (auto it = _overflow_index.find(user_data); it != _overflow_index.end()) {
+        // never submitted, complete it right away, entry stays in queue
+        // until flush_overflow() drops it
+        auto& req = *it->second;
+        _overflow_index.erase(it);
+        req.cancelled = true;
+        delete std::exchange(req.timeout, nullptr);
+        complete(user_data, -ECANCELED);
+        return;
+    }
+    enqueue(cancel_tag, nullptr, io_uring_prep_cancel64, user_data, 0);
+}
+
+template<typename Func, typename... Args>
+inline Future<int> IoEngine::request(AbortSource* abort, Deadline deadline, Func&& func, Args&&... args) {
+    if (abort && abort->abort_requested()) {
+        return make_ready_future<int>(-ECANCELED);
+    }
+    ++_stats.requests;
+    Promise<int> promise;
+    auto future = promise.get_future();
+    // promise holds state pointer, which becomes user_data of request
+    auto user_data = to_user_data(std::move(promise));
+    auto timeout = deadline == no_deadline ? nullptr : make_timespec(deadline);
+    enqueue(user_data, timeout, std::forward<Func>(func), std::forward<Args>(args)...);
+    if (abort) {
+        _abortable.emplace(user_data, abort->subscribe([this, user_data] { cancel(user_data); }));
     }
-    panic("no sqe available in io_uring");
+    return future;
 }
 
 template<typename Func, typename... Args>
@@ -1,64 +1,156 @@
 #pragma once
 
+#include "reactor/abort_source.hh"
+#include "reactor/future.hh"
 #include "reactor/reactor.hh"
 #include "reactor/task.hh"
 
 #include <liburing.h>
 
 #include <linux/time_types.h>
+#include <sys/eventfd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <unordered_map>
 
 namespace corey {
 
 constexpr auto max_events = 128u;
 constexpr int invalid_fd = -1;
 
+using Deadline = std::chrono::steady_clock::time_point;
+inline constexpr Deadline no_deadline = Deadline::max();
+
+// io_uring setup of IoEngine. Setup flags the running kernel does not
+// support are dropped with a warning, see IoEngine::setup_flags().
+struct IoEngineConfig {
+    // submission queue size, rounded up to power of two by kernel
+    unsigned sq_entries = max_events;
+    // completion queue size, 0 keeps kernel default of twice sq_entries
+    unsigned cq_entries = 0;
+    // ring is used only by the thread which created it
+    bool single_issuer = false;
+    // completions are processed only when engine polls, implies single_issuer
+    bool defer_taskrun = false;
+    // kernel does not interrupt running thread to process completions
+    bool coop_taskrun = false;
+    // rest of batch is submitted when one request fails to be prepared
+    bool submit_all = false;
+    // kernel thread polls submission queue, so submitting needs no syscall
+    // while it is awake; taskrun flags above are not used with it
+    bool sq_poll = false;
+    // how long SQ thread polls before it sleeps, zero keeps kernel default
+    std::chrono::milliseconds sq_thread_idle{0};
+    // cpu SQ thread is pinned to
+    std::optional<unsigned> sq_thread_cpu = std::nullopt;
+};
+
+struct IoEngineStats {
+    std::uint64_t requests = 0;
+    // io_uring_enter calls made to submit requests and to get completions
+    std::uint64_t submit_syscalls = 0;
+    std::uint64_t wait_syscalls = 0;
+};
+
 class IoEngine {
 public:
 
     static
     IoEngine& instance();
 
-    IoEngine(Reactor&);
+    IoEngine(Reactor&, const IoEngineConfig& config = {});
     IoEngine(const IoEngine& other) = delete;
     IoEngine& operator=(const IoEngine& other) = delete;
     IoEngine(IoEngine&& other) noexcept = delete;
     IoEngine& operator=(IoEngine&& other) noexcept = delete;
     ~IoEngine();
 
+    // Operations taking abort source complete with -ECANCELED when abort is
+    // requested before they finish. Deadline is submitted as linked timeout,
+    // kernel cancels operation with -ECANCELED when it passes.
+    //
+    // When submission queue is full, engine submits what it has; requests
+    // which still do not fit wait in overflow queue until space is freed.
     Future<int> open(const char* path, int flags);
     Future<int> open(const char* path, int flags, mode_t mode);
-    Future<int> fsync(int fd);
-    Future<int> fdatasync(int fd);
-    Future<int> read(int fd, uint64_t offset, std::span<char>);
-    Future<int> readv(int fd, uint64_t offset, std::span<iovec>);
-    Future<int> write(int fd, uint64_t offset, std::span<const char>);
-    Future<int> writev(int fd, uint64_t offset, std::span<const iovec>);
-    Future<int> send(int fd, std::span<const char>, int flags);
-    Future<int> recv(int fd, std::span<char>, int flags);
+    Future<int> fsync(int fd, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
+    Future<int> fdatasync(int fd, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
+    Future<int> read(int fd, uint64_t offset, std::span<char>, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
+    Future<int> readv(int fd, uint64_t offset, std::span<iovec>, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
+    Future<int> write(int fd, uint64_t offset, std::span<const char>, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
+    Future<int> writev(int fd, uint64_t offset, std::span<const iovec>, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
+    Future<int> send(int fd, std::span<const char>, int flags, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
+    Future<int> recv(int fd, std::span<char>, int flags, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
     Future<int> close(int fd);
-    Future<int> timeout(__kernel_timespec*);
+    Future<int> timeout(__kernel_timespec*, AbortSource* abort = nullptr);
     Future<int> socket(int domain, int type, int protocol);
-    Future<int> connect(int fd, const sockaddr* addr, socklen_t addrlen);
-    Future<int> accept(int fd, sockaddr* addr, socklen_t* addrlen);
+    Future<int> connect(int fd, const sockaddr* addr, socklen_t addrlen, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
+    Future<int> accept(int fd, sockaddr* addr, socklen_t* addrlen, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
     Future<int> setsockopt(int fd, int level, int optname, const void* optval, socklen_t optlen);
     Future<int> bind(int fd, const sockaddr* addr, socklen_t addrlen);
     Future<int> listen(int fd, int backlog);
 
+    // Writing to this eventfd wakes engine up when it waits for completions.
+    int wakeup_fd() const noexcept { return _wakeup_fd; }
+
+    // IORING_SETUP_* flags ring was created with.
+    unsigned setup_flags() const noexcept { return _ring.flags; }
+
+    const IoEngineStats& stats() const noexcept { return _stats; }
+
 private:
+    class EnginePoller;
 
+    // Request waiting in overflow queue for submission queue entry.
+    struct Overflow {
+        std::function<void(io_uring_sqe*)> prep;
+        __u64 user_data;
+        // linked timeout, or nullptr
+        __kernel_timespec* timeout;
+        // already completed by cancel(), skipped on flush
+        bool cancelled = false;
+    };
+
+    void setup_ring(const IoEngineConfig& config);
+    bool has_task_work() const noexcept;
+    bool sq_needs_wakeup() const noexcept;
     void submit_pending();
-    void complete_ready();
+    bool reserve_sqes(unsigned count);
+    void commit_sqe(io_uring_sqe* sqe, __u64 user_data, __kernel_timespec* timeout);
+    void flush_overflow();
+    void complete(__u64 user_data, int result);
+    bool complete_ready();
+    void arm_wakeup();
+    void wait();
+    void cancel(__u64 user_data);
+
+    template<typename Func, typename... Args>
+    inline void enqueue(__u64 user_data, __kernel_timespec* timeout, Func&& func, Args&&... args);
 
     template<typename Func, typename... Args>
-    inline Promise<int>* prepare(Func&& func, Args&&... args);
+    inline Future<int> request(AbortSource* abort, Deadline deadline, Func&& func, Args&&... args);
 
     template<typename Func, typename... Args>
     inline Future<int> posix_call(Func&& func, Args&&... args);
 
     io_uring _ring;
-    Defer<> _poll_routine;
+    Defer<> _poller;
+    Defer<> _sleeper;
+    // abort subscriptions of in-flight requests by user_data
+    std::unordered_map<__u64, Defer<>> _abortable;
+    std::deque<Overflow> _overflow;
+    // overflowed requests by user_data, so cancel() does not scan the queue
+    std::unordered_map<__u64, Overflow*> _overflow_index;
+    IoEngineStats _stats;
     int _pending = 0;
     int _inflight = 0;
+    int _wakeup_fd = invalid_fd;
+    bool _wakeup_armed = false;
+    eventfd_t _wakeup_value = 0;
     Reactor& _reactor;
 };
 
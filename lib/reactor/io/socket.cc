@@ -9,11 +9,20 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <system_error>
+#include <utility>
 
 namespace corey {
 
 constexpr int max_backlog = 128;
 
+namespace {
+
+std::error_code io_error(int ret) noexcept {
+    return std::error_code(-ret, std::system_category());
+}
+
+} // namespace
+
 Future<Server> Socket::make_tcp_listener(uint16_t port) {
     auto sock = co_await IoEngine::instance().socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0) {
@@ -59,14 +68,69 @@ Future<Client> Socket::make_tcp_connect(const char* host, uint16_t port) {
     co_return Client(Socket(sock));
 }
 
-Future<Client> Socket::make_accept(Socket& accepter) {
-    auto sock = co_await IoEngine::instance().accept(accepter._fd, nullptr, nullptr);
+Future<Client> Socket::make_accept(Socket& accepter, AbortSource* abort) {
+    return IoEngine::instance().accept(accepter._fd, nullptr, nullptr, abort).then([](int sock) {
+        if (sock < 0) {
+            throw std::system_error(-sock, std::system_category(), "accept failed");
+        }
+        return Client(Socket(sock));
+    });
+}
+
+Future<Result<Server>> Socket::try_make_tcp_listener(uint16_t port) {
+    auto sock = co_await IoEngine::instance().socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        co_await io_error(sock);
+    }
+
+    int optval = 1;
+    if (auto result = co_await IoEngine::instance().setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval))) {
+        co_await io_error(result);
+    }
+
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = INADDR_ANY;
+
+    if (auto result = co_await IoEngine::instance().bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+        co_await io_error(result);
+    }
+
+    if (auto result = co_await IoEngine::instance().listen(sock, max_backlog)) {
+        co_await io_error(result);
+    }
+
+    co_return Server(Socket(sock));
+}
+
+Future<Result<Client>> Socket::try_make_tcp_connect(const char* host, uint16_t port) {
+    auto sock = co_await IoEngine::instance().socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0) {
-        co_await std::make_exception_ptr(std::system_error(-sock, std::system_category(), "accept failed"));
+        co_await io_error(sock);
     }
+
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr(host);
+
+    if (auto result = co_await IoEngine::instance().connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+        co_await io_error(result);
+    }
+
     co_return Client(Socket(sock));
 }
 
+Future<Result<Client>> Socket::try_make_accept(Socket& accepter, AbortSource* abort) {
+    return IoEngine::instance().accept(accepter._fd, nullptr, nullptr, abort).then([](int sock) -> Result<Client> {
+        if (sock < 0) {
+            return io_error(sock);
+        }
+        return Client(Socket(sock));
+    });
+}
+
 Socket::Socket() noexcept : Socket(invalid_fd) {}
 
 Socket::Socket(Socket&& other) noexcept : _fd(other._fd) {
@@ -89,13 +153,25 @@ Socket::~Socket() {
 
 Future<> Socket::close() {
     if (_fd == invalid_fd) {
-        co_await std::make_exception_ptr(std::system_error(EBADF, std::system_category(), "Socket already closed"));
+        return make_exception_future<>(std::make_exception_ptr(std::system_error(EBADF, std::system_category(), "Socket already closed")));
     }
-    auto ret = co_await IoEngine::instance().close(_fd);
-    _fd = invalid_fd;
-    if (ret < 0) {
-        co_await std::make_exception_ptr(std::system_error(-ret, std::system_category(), "close failed"));
+    return IoEngine::instance().close(std::exchange(_fd, invalid_fd)).then([](int ret) {
+        if (ret < 0) {
+            throw std::system_error(-ret, std::system_category(), "close failed");
+        }
+    });
+}
+
+Future<Result<>> Socket::try_close() {
+    if (_fd == invalid_fd) {
+        return make_ready_future<Result<>>(io_error(-EBADF));
     }
+    return IoEngine::instance().close(std::exchange(_fd, invalid_fd)).then([](int ret) -> Result<> {
+        if (ret < 0) {
+            return io_error(ret);
+        }
+        return {};
+    });
 }
 
 Client::Client() noexcept = default;
@@ -104,26 +180,46 @@ Client::Client(Client&& other) noexcept= default;
 Client& Client::operator=(Client&& other) noexcept = default;
 Client::~Client() = default;
 
-Future<uint64_t> Client::read(std::span<char> data) {
-    auto result = co_await IoEngine::instance().recv(_socket.fd(), data, 0);
+Task<uint64_t> Client::read(std::span<char> data, AbortSource* abort, Deadline deadline) {
+    auto result = co_await IoEngine::instance().recv(_socket.fd(), data, 0, abort, deadline);
     if (result < 0) {
         co_await std::make_exception_ptr(std::system_error(-result, std::system_category(), "recv failed"));
     }
     co_return static_cast<uint64_t>(result);
 }
 
-Future<uint64_t> Client::write(std::span<const char> data) {
-    auto result = co_await IoEngine::instance().send(_socket.fd(), data, 0);
+Task<uint64_t> Client::write(std::span<const char> data, AbortSource* abort, Deadline deadline) {
+    auto result = co_await IoEngine::instance().send(_socket.fd(), data, 0, abort, deadline);
     if (result < 0) {
         co_await std::make_exception_ptr(std::system_error(-result, std::system_category(), "send failed"));
     }
     co_return static_cast<uint64_t>(result);
-} 
+}
+
+Task<Result<uint64_t>> Client::try_read(std::span<char> data, AbortSource* abort, Deadline deadline) {
+    auto result = co_await IoEngine::instance().recv(_socket.fd(), data, 0, abort, deadline);
+    if (result < 0) {
+        co_await io_error(result);
+    }
+    co_return static_cast<uint64_t>(result);
+}
+
+Task<Result<uint64_t>> Client::try_write(std::span<const char> data, AbortSource* abort, Deadline deadline) {
+    auto result = co_await IoEngine::instance().send(_socket.fd(), data, 0, abort, deadline);
+    if (result < 0) {
+        co_await io_error(result);
+    }
+    co_return static_cast<uint64_t>(result);
+}
 
 Future<> Client::close() {
     return _socket.close();
 }
 
+Future<Result<>> Client::try_close() {
+    return _socket.try_close();
+}
+
 Server::Server() noexcept = default;
 Server::Server(Socket&& socket) noexcept : _socket(std::move(socket)) {}
 Server::Server(Server&&) noexcept = default;
@@ -134,12 +230,26 @@ Server::~Server() {
     }
 }
 
-Future<Client> Server::accept() {
-    return Socket::make_accept(_socket);
+Future<Client> Server::accept(AbortSource* abort) {
+    return Socket::make_accept(_socket, abort);
 }
 
 Future<> Server::close() {
     return _socket.close();
 }
 
+Future<Result<Client>> Server::try_accept(AbortSource* abort) {
+    return Socket::try_make_accept(_socket, abort);
+}
+
+AsyncGenerator<Client> Server::clients(AbortSource* abort) {
+    while (true) {
+        co_yield co_await accept(abort);
+    }
+}
+
+Future<Result<>> Server::try_close() {
+    return _socket.try_close();
+}
+
 } // namespace corey
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "io.hh"
+#include "reactor/coroutine.hh"
 #include "reactor/future.hh"
+#include "utils/result.hh"
 
 #include <cstdint>
 
@@ -15,7 +17,10 @@ public:
 
     static Future<Server> make_tcp_listener(uint16_t port);
     static Future<Client> make_tcp_connect(const char* host, uint16_t port);
-    static Future<Client> make_accept(Socket& accepter);
+    static Future<Client> make_accept(Socket& accepter, AbortSource* abort = nullptr);
+    static Future<Result<Server>> try_make_tcp_listener(uint16_t port);
+    static Future<Result<Client>> try_make_tcp_connect(const char* host, uint16_t port);
+    static Future<Result<Client>> try_make_accept(Socket& accepter, AbortSource* abort = nullptr);
 
     Socket() noexcept;
     Socket(const Socket& other) = delete;
@@ -25,6 +30,7 @@ public:
     ~Socket();
 
     Future<> close();
+    Future<Result<>> try_close();
 
     int fd() const { return _fd; }
 
@@ -45,10 +51,16 @@ public:
     Client& operator=(Client&&) noexcept;
     ~Client();
 
-    Future<uint64_t> read(std::span<char>);
-    Future<uint64_t> write(std::span<const char>);
+    // Fail with std::system_error(ECANCELED) when aborted or deadline passes.
+    Task<uint64_t> read(std::span<char>, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
+    Task<uint64_t> write(std::span<const char>, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
     Future<> close();
 
+    // Errors, cancellation included, are returned as values instead of thrown.
+    Task<Result<uint64_t>> try_read(std::span<char>, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
+    Task<Result<uint64_t>> try_write(std::span<const char>, AbortSource* abort = nullptr, Deadline deadline = no_deadline);
+    Future<Result<>> try_close();
+
     const Socket& socket() const { return _socket; }
 
 private:
@@ -66,8 +78,13 @@ public:
     Server& operator=(Server&&) noexcept;
     ~Server();
 
-    Future<Client> accept();
+    Future<Client> accept(AbortSource* abort = nullptr);
     Future<> close();
+    Future<Result<Client>> try_accept(AbortSource* abort = nullptr);
+
+    // Yields accepted clients, accept failure or abort is thrown from next().
+    AsyncGenerator<Client> clients(AbortSource* abort = nullptr);
+    Future<Result<>> try_close();
 
     const Socket& socket() const { return _socket; }
 
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <memory>
+
+namespace corey {
+
+// Source of events polled by reactor on every pass. When neither tasks nor
+// pollers have work, reactor asks every poller to enter interrupt mode, in
+// which poller must make sure new events wake the reactor up, and sleeps.
+class Poller {
+public:
+    virtual ~Poller() = default;
+
+    // Processes ready events, returns true if there were any.
+    virtual bool poll() = 0;
+
+    // Checks for ready events without processing them.
+    virtual bool pure_poll() = 0;
+
+    // Returns false if events arrived and reactor must not sleep.
+    virtual bool try_enter_interrupt_mode() = 0;
+
+    virtual void exit_interrupt_mode() = 0;
+};
+
+using UPPoller = std::unique_ptr<Poller>;
+
+} // namespace corey
@@ -1,12 +1,16 @@
 #include "reactor/reactor.hh"
 #include "reactor/coroutine.hh"
+#include "reactor/stall_detector.hh"
 #include "utils/common.hh"
 
+#include <algorithm>
+#include <stdexcept>
+
 namespace corey {
 
 namespace {
 
-Reactor* g_instance = nullptr;
+thread_local Reactor* g_instance = nullptr;
 
 }
 
@@ -17,48 +21,281 @@ Reactor& Reactor::instance() {
     return *g_instance;
 }
 
-Reactor::Reactor() : _has_progress(false) {
+Reactor::Reactor() {
     COREY_ASSERT(!g_instance);
+    _groups.emplace_back("main", default_shares);
     g_instance = this;
 }
 
 Reactor::~Reactor() {
-    COREY_ASSERT(_tasks.empty());
-    COREY_ASSERT(_routines.empty());
+    COREY_ASSERT(!has_progress());
+    COREY_ASSERT(_pollers.empty());
+    COREY_ASSERT(!_sleeper);
     g_instance = nullptr;
 }
 
 void Reactor::run() {
-    for (auto& routine: _routines) {
-        routine.second.try_execute();
+    _current = 0;
+    if (poll_once() || has_progress() || run_idle_tasks()) {
+        if (_idle_start) {
+            finish_idle(std::chrono::steady_clock::now());
+        }
+    } else if (sleep()) {
+        poll_once();
     }
+    run_tasks();
+}
 
-    bool new_has_progress = false;
-    for (auto task = _tasks.begin(); task != _tasks.end();) {
-        auto next = std::next(task);
-        if (task->try_execute()) {
-            _tasks.erase_and_dispose(task, [](Executable* task) { delete task; });
-            new_has_progress = true;
+// Runs idle tasks until they are done or task quota is used up, so new
+// completions wait no longer than for a regular time slice.
+bool Reactor::run_idle_tasks() {
+    if (_idle_tasks.empty()) {
+        return false;
+    }
+    auto count = _idle_tasks.size();
+    _preempt_deadline = std::chrono::steady_clock::now() + _task_quota;
+    while (count-- > 0) {
+        auto task = std::move(_idle_tasks.front());
+        _idle_tasks.pop_front();
+        if (!task.try_execute()) {
+            _idle_tasks.push_back(std::move(task));
+        }
+        ++_idle_stats.idle_tasks_run;
+        if (need_preempt()) {
+            break;
         }
-        task = next;
     }
-    _has_progress = new_has_progress;
+    _preempt_deadline = std::chrono::steady_clock::time_point::max();
+    return true;
+}
+
+bool Reactor::poll_once() {
+    bool did_work = false;
+    for (auto& [id, poller]: _pollers) {
+        did_work |= poller->poll();
+    }
+    return did_work;
+}
+
+bool Reactor::pure_poll_once() {
+    return std::ranges::any_of(_pollers, [](auto& item) { return item.second->pure_poll(); });
+}
+
+// Called when pass found no work. Returns true when pollers should be polled
+// again, which is after reactor slept or found that sleep is not possible.
+bool Reactor::sleep() {
+    auto now = std::chrono::steady_clock::now();
+    if (!_idle_start) {
+        _idle_start = now;
+    }
+    switch (_idle_policy) {
+    case IdlePolicy::poll:
+        return false;
+    case IdlePolicy::spin:
+        if (now - *_idle_start < _spin_window) {
+            return false;
+        }
+        break;
+    case IdlePolicy::block:
+        break;
+    }
+    if (!_sleeper) {
+        return false;
+    }
+    finish_idle(now);
+    if (pure_poll_once()) {
+        return true;
+    }
+
+    auto entered = _pollers.begin();
+    while (entered != _pollers.end() && entered->second->try_enter_interrupt_mode()) {
+        ++entered;
+    }
+    if (entered == _pollers.end()) {
+        _sleeper();
+        _idle_stats.sleeping += std::chrono::steady_clock::now() - now;
+        ++_idle_stats.sleeps;
+    }
+    for (auto it = _pollers.begin(); it != entered; ++it) {
+        it->second->exit_interrupt_mode();
+    }
+    return true;
+}
+
+void Reactor::finish_idle(std::chrono::steady_clock::time_point now) {
+    _idle_stats.spinning += now - *_idle_start;
+    _idle_start.reset();
+}
+
+void Reactor::run_tasks() {
+    auto id = pick_group();
+    if (id == _groups.size()) {
+        return;
+    }
+    auto* group = &_groups[id];
+    _min_vruntime = std::max(_min_vruntime, group->vruntime);
+    _current = id;
+
+    // Only tasks scheduled before this pass are executed, tasks woken up
+    // during the pass are left for the next one. Tasks left after time
+    // slice stay at the front, ahead of woken ones.
+    auto count = group->tasks.size();
+    auto start = std::chrono::steady_clock::now();
+    _preempt_deadline = start + _task_quota;
+    while (count-- > 0) {
+        // Task is moved out, running it may grow the queue.
+        auto task = std::move(group->tasks.front());
+        group->tasks.pop_front();
+        if (_stall_detector) {
+            _stall_detector->task_started(id);
+        }
+        auto done = task.try_execute();
+        if (_stall_detector && _stall_detector->task_finished()) {
+            ++group->stalls;
+        }
+        if (!done) {
+            group->tasks.push_back(std::move(task));
+        }
+        ++group->tasks_run;
+        if (need_preempt()) {
+            break;
+        }
+    }
+    _preempt_deadline = std::chrono::steady_clock::time_point::max();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    group->runtime += elapsed;
+    group->vruntime += std::max<std::uint64_t>(elapsed.count(), 1) * default_shares / group->shares;
+    _current = 0;
 }
 
 void Reactor::add_task(Executable&& task) {
-    _tasks.push_back(*new Executable(std::move(task)));
+    add_task(std::move(task), SchedulingGroup(_current));
 }
 
-Defer<> Reactor::add_routine(Executable&& routine) {
-    uint16_t id = _routines.size();
-    auto start = id;
-    while(_routines.count(id++)) { COREY_ASSERT(id != start); }
-    _routines[id] = std::move(routine);
-    return defer([this, id]() noexcept { remove_routine(id);});
+void Reactor::add_task(Executable&& task, SchedulingGroup sg) {
+    auto& target = group(sg);
+    if (target.tasks.empty()) {
+        // Idle group must not catch up on time it did not use.
+        target.vruntime = std::max(target.vruntime, _min_vruntime);
+    }
+    target.tasks.push_back(std::move(task));
+}
+
+void Reactor::add_idle_task(Executable&& task) {
+    _idle_tasks.push_back(std::move(task));
+}
+
+void Reactor::set_task_quota(std::chrono::nanoseconds quota) {
+    if (quota <= std::chrono::nanoseconds::zero()) {
+        throw std::invalid_argument("task quota must be positive");
+    }
+    _task_quota = quota;
+}
+
+void Reactor::enable_stall_detector(std::chrono::nanoseconds threshold) {
+    _stall_detector.reset();
+    _stall_detector = std::make_unique<StallDetector>(threshold);
+}
+
+void Reactor::disable_stall_detector() noexcept {
+    _stall_detector.reset();
+}
+
+bool Reactor::has_progress() const {
+    return std::ranges::any_of(_groups, [](const Group& group) { return !group.tasks.empty(); });
+}
+
+SchedulingGroup Reactor::create_scheduling_group(std::string name, unsigned shares) {
+    if (shares == 0) {
+        throw std::invalid_argument("scheduling group shares must be positive");
+    }
+    if (std::ranges::any_of(_groups, [&name](const Group& group) { return group.name == name; })) {
+        throw std::invalid_argument(fmt::format("scheduling group '{}' already exists", name));
+    }
+    auto& group = _groups.emplace_back(std::move(name), shares);
+    group.vruntime = _min_vruntime;
+    return SchedulingGroup(static_cast<unsigned>(_groups.size() - 1));
+}
+
+Reactor::Group& Reactor::group(SchedulingGroup sg) {
+    if (sg.id() >= _groups.size()) {
+        throw std::out_of_range(fmt::format("unknown scheduling group {}", sg.id()));
+    }
+    return _groups[sg.id()];
+}
+
+unsigned Reactor::pick_group() const noexcept {
+    unsigned result = _groups.size();
+    for (unsigned id = 0; id < _groups.size(); ++id) {
+        auto& group = _groups[id];
+        if (!group.tasks.empty() && (result == _groups.size() || group.vruntime < _groups[result].vruntime)) {
+            result = id;
+        }
+    }
+    return result;
+}
+
+Defer<> Reactor::add_poller(UPPoller&& poller) {
+    int id = _pollers.empty() ? 0 : _pollers.rbegin()->first + 1;
+    _pollers.emplace(id, std::move(poller));
+    return defer([this, id]() noexcept { remove_poller(id); });
+}
+
+void Reactor::remove_poller(int id) {
+    _pollers.erase(id);
+}
+
+Defer<> Reactor::set_sleeper(std::function<void()>&& sleeper) {
+    COREY_ASSERT(!_sleeper);
+    _sleeper = std::move(sleeper);
+    return defer([this]() noexcept { _sleeper = nullptr; });
+}
+
+void Reactor::set_idle_policy(IdlePolicy policy, std::chrono::nanoseconds spin_window) {
+    if (spin_window < std::chrono::nanoseconds::zero()) {
+        throw std::invalid_argument("spin window must not be negative");
+    }
+    _idle_policy = policy;
+    _spin_window = spin_window;
+}
+
+IdlePolicy parse_idle_policy(std::string_view text) {
+    if (text == "block") {
+        return IdlePolicy::block;
+    }
+    if (text == "spin") {
+        return IdlePolicy::spin;
+    }
+    if (text == "poll") {
+        return IdlePolicy::poll;
+    }
+    throw std::invalid_argument(fmt::format("unknown idle policy '{}'", text));
+}
+
+const std::string& SchedulingGroup::name() const {
+    return Reactor::instance().group(*this).name;
+}
+
+unsigned SchedulingGroup::shares() const {
+    return Reactor::instance().group(*this).shares;
+}
+
+void SchedulingGroup::set_shares(unsigned shares) {
+    if (shares == 0) {
+        throw std::invalid_argument("scheduling group shares must be positive");
+    }
+    Reactor::instance().group(*this).shares = shares;
 }
 
-void Reactor::remove_routine(int id) {
-    _routines.erase(id);
+SchedulingGroupStats SchedulingGroup::stats() const {
+    auto& group = Reactor::instance().group(*this);
+    return {
+        .runtime = group.runtime,
+        .vruntime = std::chrono::nanoseconds(group.vruntime),
+        .tasks_run = group.tasks_run,
+        .stalls = group.stalls,
+    };
 }
 
 } // namespace corey
@@ -1,19 +1,81 @@
 #pragma once
 
+#include "reactor/circular_buffer.hh"
+#include "reactor/poller.hh"
 #include "reactor/task.hh"
-#include "reactor/future.hh"
 #include "common/defer.hh"
 
-#include <boost/intrusive/list.hpp>
 #include <boost/container/flat_map.hpp>
 
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
 namespace corey {
 
+struct SchedulingGroupStats {
+    std::chrono::nanoseconds runtime{0};
+    std::chrono::nanoseconds vruntime{0};
+    std::uint64_t tasks_run = 0;
+    std::uint64_t stalls = 0;
+};
+
+class StallDetector;
+
+// What reactor does when neither tasks nor pollers have work.
+enum class IdlePolicy {
+    block,  // sleep right away
+    spin,   // keep polling for a while, then sleep
+    poll    // never sleep
+};
+
+IdlePolicy parse_idle_policy(std::string_view);
+
+struct IdleStats {
+    std::chrono::nanoseconds spinning{0};
+    std::chrono::nanoseconds sleeping{0};
+    std::uint64_t sleeps = 0;
+    std::uint64_t idle_tasks_run = 0;
+};
+
+// Handle to a scheduling group of the current reactor. Default constructed
+// handle refers to the main group, which every reactor has.
+class SchedulingGroup {
+public:
+    SchedulingGroup() noexcept = default;
+
+    unsigned id() const noexcept { return _id; }
+    const std::string& name() const;
+    unsigned shares() const;
+    void set_shares(unsigned shares);
+    SchedulingGroupStats stats() const;
+
+    bool operator==(const SchedulingGroup&) const noexcept = default;
+
+private:
+    friend class Reactor;
+    explicit SchedulingGroup(unsigned id) noexcept : _id(id) {}
+
+    unsigned _id = 0;
+};
+
 class Reactor {
-    using TaskList = boost::intrusive::list<Executable, boost::intrusive::constant_time_size<false>>;
-    using RoutineList = boost::container::flat_map<int, Executable>;
+    using TaskList = CircularBuffer<Executable>;
+    using PollerList = boost::container::flat_map<int, UPPoller>;
 public:
 
+    static constexpr unsigned default_shares = 1000;
+    // Time a group may run before reactor returns to polling and picks
+    // the next group.
+    static constexpr std::chrono::microseconds default_task_quota{500};
+    static constexpr std::chrono::microseconds default_spin_window{50};
+
     static
     Reactor& instance();
 
@@ -26,19 +88,119 @@ public:
 
     void run();
     void add_task(Executable&&);
-    Defer<> add_routine(Executable&&);
+    void add_task(Executable&&, SchedulingGroup);
 
-    bool has_progress() const {
-        return _has_progress;
+    // Idle task runs only on passes without ready tasks and completions,
+    // before reactor would sleep. Task returning false is kept and run again
+    // on the next idle pass. Idle tasks left on destruction are dropped.
+    void add_idle_task(Executable&&);
+
+    // Poller is polled on every pass until returned defer is destroyed.
+    Defer<> add_poller(UPPoller&&);
+
+    // Sleeper blocks thread until some poller in interrupt mode is woken up.
+    // Without one reactor never sleeps. Set by IoEngine.
+    Defer<> set_sleeper(std::function<void()>&&);
+
+    IdlePolicy idle_policy() const noexcept { return _idle_policy; }
+    std::chrono::nanoseconds spin_window() const noexcept { return _spin_window; }
+    // Spin window is used only by IdlePolicy::spin.
+    void set_idle_policy(IdlePolicy policy, std::chrono::nanoseconds spin_window = default_spin_window);
+
+    const IdleStats& idle_stats() const noexcept { return _idle_stats; }
+
+    bool has_progress() const;
+
+    // True when running task has used up the task quota and should yield
+    // to let reactor poll for completions. Always false outside of run().
+    static bool need_preempt() noexcept {
+        return std::chrono::steady_clock::now() >= _preempt_deadline;
     }
 
+    std::chrono::nanoseconds task_quota() const noexcept { return _task_quota; }
+    void set_task_quota(std::chrono::nanoseconds quota);
+
+    // Reports tasks running longer than threshold and counts them in
+    // stats of their scheduling group, see StallDetector.
+    void enable_stall_detector(std::chrono::nanoseconds threshold);
+    void disable_stall_detector() noexcept;
+
+    SchedulingGroup create_scheduling_group(std::string name, unsigned shares);
+    SchedulingGroup current_scheduling_group() const noexcept { return SchedulingGroup(_current); }
+
 private:
+    friend class SchedulingGroup;
 
-    void remove_routine(int id);
+    template<typename Func>
+    friend auto with_scheduling_group(SchedulingGroup, Func&&);
 
-    TaskList _tasks;
-    RoutineList _routines;
-    bool _has_progress;
+    struct Group {
+        Group(std::string name, unsigned shares) : name(std::move(name)), shares(shares) {}
+
+        std::string name;
+        unsigned shares;
+        TaskList tasks;
+        // Runtime scaled by default_shares/shares, group with the smallest
+        // value among groups with ready tasks runs next.
+        std::uint64_t vruntime = 0;
+        std::chrono::nanoseconds runtime{0};
+        std::uint64_t tasks_run = 0;
+        std::uint64_t stalls = 0;
+    };
+
+    Group& group(SchedulingGroup sg);
+    // Returns group with ready tasks and the smallest vruntime or
+    // _groups.size() if there are none.
+    unsigned pick_group() const noexcept;
+    void run_tasks();
+    bool run_idle_tasks();
+    bool poll_once();
+    bool pure_poll_once();
+    bool sleep();
+    void finish_idle(std::chrono::steady_clock::time_point now);
+    void remove_poller(int id);
+
+    // Deque keeps references valid when groups are created by running tasks.
+    std::deque<Group> _groups;
+    TaskList _idle_tasks;
+    unsigned _current = 0;
+    std::uint64_t _min_vruntime = 0;
+    std::chrono::nanoseconds _task_quota = default_task_quota;
+    std::unique_ptr<StallDetector> _stall_detector;
+    PollerList _pollers;
+    std::function<void()> _sleeper;
+    IdlePolicy _idle_policy = IdlePolicy::block;
+    std::chrono::nanoseconds _spin_window = default_spin_window;
+    std::optional<std::chrono::steady_clock::time_point> _idle_start;
+    IdleStats _idle_stats;
+
+    static inline thread_local std::chrono::steady_clock::time_point _preempt_deadline
+        = std::chrono::steady_clock::time_point::max();
 };
 
+inline bool need_preempt() noexcept {
+    return Reactor::need_preempt();
+}
+
+inline SchedulingGroup create_scheduling_group(std::string name, unsigned shares) {
+    return Reactor::instance().create_scheduling_group(std::move(name), shares);
+}
+
+inline SchedulingGroup current_scheduling_group() {
+    return Reactor::instance().current_scheduling_group();
+}
+
+// Calls func with group made current. Tasks and coroutines started by func
+// run in this group and so do their continuations.
+template<typename Func>
+auto with_scheduling_group(SchedulingGroup sg, Func&& func) {
+    auto& reactor = Reactor::instance();
+    reactor.group(sg);
+    auto restore = defer([&reactor, prev = reactor._current]() noexcept {
+        reactor._current = prev;
+    });
+    reactor._current = sg.id();
+    return std::forward<Func>(func)();
+}
+
 } // namespace corey
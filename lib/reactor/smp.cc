@@ -0,0 +1,479 @@
+#include "reactor/smp.hh"
+#include "reactor/reactor.hh"
+#include "reactor/spsc.hh"
+#include "reactor/io/io.hh"
+#include "utils/common.hh"
+#include "utils/log.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <climits>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <latch>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace corey {
+
+namespace {
+
+Log logger("smp");
+
+constexpr std::size_t channel_capacity = 128;
+
+thread_local ShardId g_shard_id = 0;
+std::atomic<ShardId> g_shard_count = 1;
+Smp* g_smp = nullptr;
+
+void set_thread_cpus(const std::vector<unsigned>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu: cpus) {
+        CPU_SET(cpu, &set);
+    }
+    if (auto err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); err != 0) {
+        throw std::system_error(err, std::system_category(), "pthread_setaffinity_np failed");
+    }
+}
+
+// Preferred rather than strict binding, so shard still gets memory when
+// its node runs out of it.
+void set_thread_node(unsigned node) {
+    constexpr auto bits = sizeof(unsigned long) * CHAR_BIT;
+    std::array<unsigned long, 16> mask = {};
+    if (node >= mask.size() * bits) {
+        throw std::invalid_argument(fmt::format("invalid numa node: {}", node));
+    }
+    mask[node / bits] |= 1ul << (node % bits);
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * bits + 1) != 0) {
+        throw std::system_error(errno, std::system_category(), "set_mempolicy failed");
+    }
+}
+
+void reset_thread_node() {
+    if (syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0) != 0) {
+        throw std::system_error(errno, std::system_category(), "set_mempolicy failed");
+    }
+}
+
+unsigned parse_cpu(std::string_view text) {
+    unsigned cpu = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), cpu);
+    if ((ec != std::errc()) || (ptr != text.data() + text.size()) || (cpu >= CPU_SETSIZE)) {
+        throw std::invalid_argument(fmt::format("invalid cpu: '{}'", text));
+    }
+    return cpu;
+}
+
+} // namespace
+
+struct Smp::Shard {
+    ShardId id;
+    unsigned cpu;
+    unsigned node = 0;
+    int wakeup_fd = invalid_fd;
+    std::atomic<bool> stop = false;
+    std::exception_ptr error;
+    std::thread thread;
+    Defer<> poller;
+    // owned by shard thread
+    bool flush_scheduled = false;
+    // set while shard reactor sleeps, cleared by first producer waking it up
+    alignas(cache_line_size) std::atomic<bool> sleeping = false;
+};
+
+struct Smp::Channel {
+    SpscQueue<SmpMessage*, channel_capacity> queue;
+    // owned by producer, keeps messages that did not fit into queue
+    std::deque<SmpMessage*> overflow;
+};
+
+class Smp::ShardPoller final : public Poller {
+public:
+    ShardPoller(Smp& smp, ShardId self) noexcept : _smp(smp), _self(self) {}
+
+    bool poll() override {
+        return _smp.poll(_self);
+    }
+
+    bool pure_poll() override {
+        return _smp.has_incoming(_self);
+    }
+
+    // Pairs with fence in Smp::wake: either producer sees the flag and
+    // writes eventfd, or shard sees published messages and stays awake.
+    bool try_enter_interrupt_mode() override {
+        auto& sleeping = _smp._shards[_self]->sleeping;
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_smp.has_incoming(_self)) {
+            sleeping.store(false, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    void exit_interrupt_mode() override {
+        _smp._shards[_self]->sleeping.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    Smp& _smp;
+    ShardId _self;
+};
+
+void SmpMessage::run() {
+    if (!_processed) {
+        process();
+    } else {
+        complete();
+    }
+}
+
+void SmpMessage::respond() {
+    _processed = true;
+    Smp::send(_origin, this);
+}
+
+ShardId Smp::shard_id() noexcept {
+    return g_shard_id;
+}
+
+ShardId Smp::count() noexcept {
+    return g_shard_count.load(std::memory_order_relaxed);
+}
+
+std::optional<ShardPlacement> Smp::placement(ShardId id) {
+    if (!g_smp || id >= g_smp->_shards.size()) {
+        return std::nullopt;
+    }
+    auto& shard = *g_smp->_shards[id];
+    return ShardPlacement{ .cpu = shard.cpu, .node = shard.node };
+}
+
+Smp::Smp(const std::vector<unsigned>& cpus, ShardFunc on_start, SmpOptions options) : _options(options) {
+    if (cpus.empty()) {
+        throw std::invalid_argument("no cpus for shards");
+    }
+    COREY_ASSERT(count() == 1);
+
+    _saved_affinity = get_thread_cpus();
+    set_thread_cpus({cpus.front()});
+    g_shard_count = cpus.size();
+    g_smp = this;
+
+    auto nodes = get_numa_nodes();
+    for (ShardId id = 0; id < cpus.size(); ++id) {
+        auto& shard = *_shards.emplace_back(std::make_unique<Shard>());
+        shard.id = id;
+        shard.cpu = cpus[id];
+        for (auto& node: nodes) {
+            if (std::ranges::find(node.cpus, shard.cpu) != node.cpus.end()) {
+                shard.node = node.id;
+            }
+        }
+    }
+    for (std::size_t idx = 0; idx < cpus.size() * cpus.size(); ++idx) {
+        _channels.emplace_back(std::make_unique<Channel>());
+    }
+
+    auto& local = *_shards.front();
+    // Reactor of calling thread already exists, so only allocations made
+    // from now on, IoEngine ring included, are node-local on shard 0.
+    try {
+        if (_options.numa_aware) {
+            set_thread_node(local.node);
+        }
+        _local_engine.emplace(Reactor::instance(), _options.io);
+    } catch (...) {
+        stop();
+        throw;
+    }
+    local.wakeup_fd = dup(_local_engine->wakeup_fd());
+    if (local.wakeup_fd < 0) {
+        auto err = errno;
+        stop();
+        throw std::system_error(err, std::system_category(), "dup failed");
+    }
+    local.poller = Reactor::instance().add_poller(std::make_unique<ShardPoller>(*this, 0));
+
+    // services may send messages right away, so every shard must be able to
+    // receive them before first service is started
+    std::latch initialized(cpus.size() - 1);
+    std::latch started(cpus.size() - 1);
+    for (auto& ptr: std::span(_shards).subspan(1)) {
+        auto& shard = *ptr;
+        shard.thread = std::thread([this, &shard, &on_start, &initialized, &started] {
+            g_shard_id = shard.id;
+            std::optional<Reactor> reactor;
+            std::optional<IoEngine> engine;
+            std::optional<Future<>> service;
+            try {
+                set_thread_cpus({shard.cpu});
+                if (_options.numa_aware) {
+                    set_thread_node(shard.node);
+                }
+                reactor.emplace();
+                engine.emplace(*reactor, _options.io);
+                shard.wakeup_fd = dup(engine->wakeup_fd());
+                if (shard.wakeup_fd < 0) {
+                    throw std::system_error(errno, std::system_category(), "dup failed");
+                }
+                shard.poller = reactor->add_poller(std::make_unique<ShardPoller>(*this, shard.id));
+            } catch (...) {
+                shard.error = std::current_exception();
+            }
+            initialized.arrive_and_wait();
+            if (!shard.error) {
+                try {
+                    service.emplace(on_start());
+                } catch (...) {
+                    shard.error = std::current_exception();
+                }
+            }
+            started.count_down();
+            if (!shard.error) {
+                while (!shard.stop.load(std::memory_order_acquire)) {
+                    reactor->run();
+                }
+                while (reactor->has_progress()) {
+                    reactor->run();
+                }
+                if (service->is_ready() && service->has_failed()) {
+                    logger.error("shard {} service failed", shard.id);
+                    log_orphaned_exception(service->get_exception());
+                }
+            }
+            shard.poller = {};
+            // engine completes in-flight requests with -ECANCELED, their
+            // awaiters must run before reactor is destroyed
+            engine.reset();
+            while (reactor && reactor->has_progress()) {
+                reactor->run();
+            }
+        });
+    }
+    started.wait();
+
+    for (auto& shard: _shards) {
+        if (shard->error) {
+            auto error = shard->error;
+            stop();
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+Smp::~Smp() {
+    stop();
+}
+
+void Smp::send(ShardId target, SmpMessage* msg) {
+    COREY_ASSERT(g_smp != nullptr);
+    auto self = shard_id();
+    auto& chan = g_smp->channel(self, target);
+    if (!chan.overflow.empty() || !chan.queue.try_push(std::move(msg))) {
+        chan.overflow.push_back(msg);
+    }
+    g_smp->schedule_flush(self);
+}
+
+Smp::Channel& Smp::channel(ShardId from, ShardId to) noexcept {
+    return *_channels[from * _shards.size() + to];
+}
+
+bool Smp::poll(ShardId self) {
+    std::size_t count = 0;
+    for (ShardId from = 0; from < _shards.size(); ++from) {
+        if (from != self) {
+            count += channel(from, self).queue.consume([](SmpMessage* msg) { msg->run(); });
+        }
+    }
+    return count > 0;
+}
+
+bool Smp::has_incoming(ShardId self) noexcept {
+    for (ShardId from = 0; from < _shards.size(); ++from) {
+        if (from != self && !channel(from, self).queue.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Smp::schedule_flush(ShardId self) {
+    auto& shard = *_shards[self];
+    if (shard.flush_scheduled) {
+        return;
+    }
+    shard.flush_scheduled = true;
+    // flush runs as a task, so reactor does not go to sleep with
+    // messages which are not handed over yet
+    Reactor::instance().add_task(make_task([this, self] { flush(self); }));
+}
+
+void Smp::flush(ShardId self) {
+    _shards[self]->flush_scheduled = false;
+    bool has_overflow = false;
+    for (ShardId to = 0; to < _shards.size(); ++to) {
+        if (to == self) {
+            continue;
+        }
+        auto& chan = channel(self, to);
+        while (!chan.overflow.empty() && chan.queue.try_push(std::move(chan.overflow.front()))) {
+            chan.overflow.pop_front();
+        }
+        if (chan.queue.publish()) {
+            wake(to);
+        }
+        has_overflow |= !chan.overflow.empty();
+    }
+    if (has_overflow) {
+        schedule_flush(self);
+    }
+}
+
+void Smp::wake(ShardId target) {
+    auto& shard = *_shards[target];
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // busy shard polls queues by itself, no syscall needed
+    if (shard.sleeping.load(std::memory_order_relaxed) && shard.sleeping.exchange(false, std::memory_order_relaxed)) {
+        eventfd_write(shard.wakeup_fd, 1);
+    }
+}
+
+void Smp::stop() noexcept {
+    for (auto& shard: std::span(_shards).subspan(1)) {
+        shard->stop.store(true, std::memory_order_release);
+        if (shard->wakeup_fd != invalid_fd) {
+            eventfd_write(shard->wakeup_fd, 1);
+        }
+    }
+    for (auto& shard: _shards) {
+        if (shard->thread.joinable()) {
+            shard->thread.join();
+        }
+    }
+    // running shards may wake each other until last one is joined
+    for (auto& shard: _shards) {
+        if (shard->wakeup_fd != invalid_fd) {
+            ::close(shard->wakeup_fd);
+        }
+    }
+    if (!_shards.empty()) {
+        _shards.front()->poller = {};
+    }
+    if (_local_engine) {
+        // awaiters of requests cancelled by engine run while reactor exists
+        _local_engine.reset();
+        auto& reactor = Reactor::instance();
+        while (reactor.has_progress()) {
+            reactor.run();
+        }
+    }
+    _shards.clear();
+    _channels.clear();
+    g_smp = nullptr;
+    g_shard_count = 1;
+    try {
+        set_thread_cpus(_saved_affinity);
+        if (_options.numa_aware) {
+            reset_thread_node();
+        }
+    } catch (const std::exception& e) {
+        logger.warn("failed to restore affinity: {}", e.what());
+    }
+}
+
+std::vector<unsigned> parse_cpuset(std::string_view text) {
+    std::vector<unsigned> result;
+    for (auto comma = std::string_view::size_type(0); comma != std::string_view::npos;) {
+        comma = text.find(',');
+        auto item = text.substr(0, comma);
+        text = text.substr((comma == std::string_view::npos) ? text.size() : comma + 1);
+
+        if (auto dash = item.find('-'); dash != std::string_view::npos) {
+            auto first = parse_cpu(item.substr(0, dash));
+            auto last = parse_cpu(item.substr(dash + 1));
+            if (first > last) {
+                throw std::invalid_argument(fmt::format("invalid cpu range: '{}'", item));
+            }
+            for (auto cpu = first; cpu <= last; ++cpu) {
+                result.push_back(cpu);
+            }
+        } else {
+            result.push_back(parse_cpu(item));
+        }
+    }
+    return result;
+}
+
+std::vector<unsigned> get_thread_cpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (auto err = pthread_getaffinity_np(pthread_self(), sizeof(set), &set); err != 0) {
+        throw std::system_error(err, std::system_category(), "pthread_getaffinity_np failed");
+    }
+    std::vector<unsigned> result;
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+            result.push_back(cpu);
+        }
+    }
+    return result;
+}
+
+std::vector<NumaNode> get_numa_nodes() {
+    namespace fs = std::filesystem;
+    constexpr std::string_view prefix = "node";
+
+    std::vector<NumaNode> result;
+    std::error_code ec;
+    for (auto& entry: fs::directory_iterator("/sys/devices/system/node", ec)) {
+        auto name = entry.path().filename().string();
+        if (!name.starts_with(prefix)) {
+            continue;
+        }
+        unsigned id = 0;
+        auto digits = std::string_view(name).substr(prefix.size());
+        auto [ptr, err] = std::from_chars(digits.data(), digits.data() + digits.size(), id);
+        if ((err != std::errc()) || (ptr != digits.data() + digits.size())) {
+            continue;
+        }
+        std::string cpulist;
+        std::ifstream(entry.path() / "cpulist") >> cpulist;
+        auto& node = result.emplace_back(NumaNode{ .id = id, .cpus = {} });
+        // memory-only nodes have empty cpu list
+        if (!cpulist.empty()) {
+            node.cpus = parse_cpuset(cpulist);
+        }
+    }
+    std::ranges::sort(result, {}, &NumaNode::id);
+    return result;
+}
+
+unsigned get_numa_node(unsigned cpu) {
+    for (auto& node: get_numa_nodes()) {
+        if (std::ranges::find(node.cpus, cpu) != node.cpus.end()) {
+            return node.id;
+        }
+    }
+    return 0;
+}
+
+} // namespace corey
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "reactor/future.hh"
+#include "reactor/io/io.hh"
+#include "reactor/task.hh"
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace corey {
+
+using ShardId = unsigned;
+
+// Message travels to target shard, gets processed there and travels back
+// to origin shard to be completed. Only origin shard touches Promise.
+class SmpMessage {
+public:
+    SmpMessage(ShardId origin, ShardId target) noexcept : _origin(origin), _target(target) {}
+    virtual ~SmpMessage() = default;
+
+    void run();
+
+protected:
+    virtual void process() = 0;
+    virtual void complete() = 0;
+
+    void respond();
+
+private:
+    ShardId _origin;
+    ShardId _target;
+    bool _processed = false;
+};
+
+struct SmpOptions {
+    // Shard threads prefer memory of NUMA node their cpu belongs to. IoEngine
+    // of every shard, and Reactor of new ones, are created after that, so
+    // io_uring rings are node-local too.
+    bool numa_aware = false;
+    // ring setup of IoEngine of every shard
+    IoEngineConfig io;
+};
+
+struct ShardPlacement {
+    unsigned cpu;
+    unsigned node;
+};
+
+class Smp {
+public:
+    using ShardFunc = std::function<Future<>()>;
+
+    static ShardId shard_id() noexcept;
+    static ShardId count() noexcept;
+
+    // Returns nullopt when shards are not running.
+    static std::optional<ShardPlacement> placement(ShardId);
+
+    // Calling thread becomes shard 0 pinned to cpus[0], every other cpu gets
+    // its own thread with Reactor and IoEngine. IoEngine of shard 0 is also
+    // created here once thread is pinned, so calling thread must have none.
+    // on_start is called on every new shard, shard keeps running until Smp
+    // is destroyed.
+    Smp(const std::vector<unsigned>& cpus, ShardFunc on_start, SmpOptions options = {});
+    Smp(const Smp&) = delete;
+    Smp& operator=(const Smp&) = delete;
+    Smp(Smp&&) = delete;
+    Smp& operator=(Smp&&) = delete;
+    ~Smp();
+
+    // Enqueues message from current shard to target, messages are handed
+    // over to target in batches once per reactor pass.
+    static void send(ShardId target, SmpMessage* msg);
+
+private:
+    struct Shard;
+    struct Channel;
+    class ShardPoller;
+
+    Channel& channel(ShardId from, ShardId to) noexcept;
+    bool poll(ShardId self);
+    bool has_incoming(ShardId self) noexcept;
+    void flush(ShardId self);
+    void schedule_flush(ShardId self);
+    void wake(ShardId target);
+    void stop() noexcept;
+
+    std::vector<std::unique_ptr<Shard>> _shards;
+    std::vector<std::unique_ptr<Channel>> _channels;
+    std::vector<unsigned> _saved_affinity;
+    SmpOptions _options;
+    std::optional<IoEngine> _local_engine;
+};
+
+template<typename Func>
+class SmpTask final : public SmpMessage {
+    using Result = std::invoke_result_t<Func>;
+    using Data = typename FutureTraits<Result>::Type;
+    using Value = std::conditional_t<std::is_void_v<Data>, std::monostate, Data>;
+public:
+    template<typename Arg>
+    SmpTask(ShardId target, Arg&& func)
+        : SmpMessage(Smp::shard_id(), target)
+        , _func(std::in_place, std::forward<Arg>(func)) {}
+
+    Future<Data> get_future() { return _promise.get_future(); }
+
+private:
+    void process() override {
+        try {
+            if constexpr (FutureTraits<Result>::is_future) {
+                _pending.emplace(std::invoke(std::move(*_func)));
+                _func.reset();
+                _pending->set_continuation(make_task([this] {
+                    take_result(*_pending);
+                    _pending.reset();
+                    respond();
+                }));
+                return;
+            } else if constexpr (std::is_void_v<Data>) {
+                std::invoke(std::move(*_func));
+                _value.emplace();
+            } else {
+                _value.emplace(std::invoke(std::move(*_func)));
+            }
+        } catch (...) {
+            _error = std::current_exception();
+        }
+        _func.reset();
+        respond();
+    }
+
+    void complete() override {
+        if (_error) {
+            _promise.set_exception(_error);
+        } else if constexpr (std::is_void_v<Data>) {
+            _promise.set();
+        } else {
+            _promise.set(std::move(*_value));
+        }
+        delete this;
+    }
+
+    void take_result(Future<Data>& fut) {
+        if (fut.has_failed()) {
+            _error = fut.get_exception();
+        } else if constexpr (std::is_void_v<Data>) {
+            _value.emplace();
+        } else {
+            _value.emplace(fut.get());
+        }
+    }
+
+    std::optional<Func> _func;
+    std::optional<Future<Data>> _pending;
+    std::optional<Value> _value;
+    std::exception_ptr _error;
+    Promise<Data> _promise;
+};
+
+// Runs func on target shard, result is delivered back to calling shard.
+// Func may return value or Future.
+template<typename Func>
+auto submit_to(ShardId target, Func&& func) {
+    using Result = std::invoke_result_t<Func>;
+    using Data = typename FutureTraits<Result>::Type;
+    if (target >= Smp::count()) {
+        return make_exception_future<Data>(std::make_exception_ptr(std::out_of_range("invalid shard id")));
+    }
+    if (target == Smp::shard_id()) {
+        try {
+            if constexpr (FutureTraits<Result>::is_future) {
+                return std::invoke(std::forward<Func>(func));
+            } else if constexpr (std::is_void_v<Data>) {
+                std::invoke(std::forward<Func>(func));
+                return make_ready_future<Data>();
+            } else {
+                return make_ready_future<Data>(std::invoke(std::forward<Func>(func)));
+            }
+        } catch (...) {
+            return make_exception_future<Data>(std::current_exception());
+        }
+    }
+    auto msg = new SmpTask<std::decay_t<Func>>(target, std::forward<Func>(func));
+    auto fut = msg->get_future();
+    Smp::send(target, msg);
+    return fut;
+}
+
+// Parses cpu list in form "0-3,8,10"
+std::vector<unsigned> parse_cpuset(std::string_view);
+
+// Returns cpus from affinity mask of calling thread
+std::vector<unsigned> get_thread_cpus();
+
+struct NumaNode {
+    unsigned id;
+    std::vector<unsigned> cpus;
+};
+
+// Returns NUMA nodes reported by sysfs, empty if kernel reports none.
+std::vector<NumaNode> get_numa_nodes();
+
+// Returns NUMA node of cpu, 0 if it is unknown.
+unsigned get_numa_node(unsigned cpu);
+
+} // namespace corey
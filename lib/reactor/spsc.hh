@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace corey {
+
+inline constexpr std::size_t cache_line_size = 64;
+
+// Single producer single consumer ring.
+//
+// Producer pushes items without making them visible to consumer, publish()
+// hands over the whole batch with one store. Consumer takes everything
+// published so far and releases slots with one store as well. Each side
+// keeps a cached copy of other side index and reads shared one only when
+// cache says there is no space (producer) or no items (consumer).
+template<typename Data, std::size_t Capacity>
+requires ((Capacity & (Capacity - 1)) == 0)
+class SpscQueue {
+public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+    SpscQueue(SpscQueue&&) = delete;
+    SpscQueue& operator=(SpscQueue&&) = delete;
+    ~SpscQueue() = default;
+
+    static constexpr std::size_t capacity() noexcept { return Capacity; }
+
+    bool try_push(Data&& data) {
+        if (_producer.tail - _producer.head_cache == Capacity) {
+            _producer.head_cache = _head.load(std::memory_order_acquire);
+            if (_producer.tail - _producer.head_cache == Capacity) {
+                return false;
+            }
+        }
+        _ring[_producer.tail++ & (Capacity - 1)] = std::move(data);
+        return true;
+    }
+
+    // Returns true, when new items were made visible to consumer
+    bool publish() noexcept {
+        if (_producer.tail == _producer.published) {
+            return false;
+        }
+        _producer.published = _producer.tail;
+        _tail.store(_producer.published, std::memory_order_release);
+        return true;
+    }
+
+    template<typename Func>
+    std::size_t consume(Func&& func) {
+        auto tail = _tail.load(std::memory_order_acquire);
+        auto count = tail - _consumer.head;
+        for (; _consumer.head != tail; ++_consumer.head) {
+            func(std::move(_ring[_consumer.head & (Capacity - 1)]));
+        }
+        if (count > 0) {
+            _head.store(_consumer.head, std::memory_order_release);
+        }
+        return count;
+    }
+
+    // Consumer side check for published items.
+    bool empty() const noexcept {
+        return _tail.load(std::memory_order_acquire) == _consumer.head;
+    }
+
+private:
+    struct alignas(cache_line_size) {
+        std::size_t tail = 0;
+        std::size_t published = 0;
+        std::size_t head_cache = 0;
+    } _producer;
+
+    struct alignas(cache_line_size) {
+        std::size_t head = 0;
+    } _consumer;
+
+    alignas(cache_line_size) std::atomic<std::size_t> _tail = 0;
+    alignas(cache_line_size) std::atomic<std::size_t> _head = 0;
+    alignas(cache_line_size) std::array<Data, Capacity> _ring;
+};
+
+} // namespace corey
@@ -0,0 +1,135 @@
+#include "reactor/stall_detector.hh"
+#include "utils/common.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <execinfo.h>
+
+namespace corey {
+
+namespace {
+
+using namespace std::chrono_literals;
+
+thread_local StallDetector* g_detector = nullptr;
+
+constexpr auto min_sample_period = std::chrono::nanoseconds(100us);
+constexpr auto capture_timeout = 100ms;
+
+int stall_signal() {
+    return SIGRTMIN;
+}
+
+} // namespace
+
+StallDetector::StallDetector(std::chrono::nanoseconds threshold)
+    : _threshold(threshold)
+    , _reactor_thread(pthread_self())
+    , _log("stall") {
+    if (threshold <= std::chrono::nanoseconds::zero()) {
+        throw std::invalid_argument("stall threshold must be positive");
+    }
+    COREY_ASSERT(!g_detector);
+
+    static std::once_flag install_handler;
+    std::call_once(install_handler, [] {
+        struct sigaction action = {};
+        action.sa_handler = &StallDetector::on_signal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(stall_signal(), &action, nullptr) != 0) {
+            throw std::system_error(errno, std::system_category(), "sigaction");
+        }
+    });
+
+    // First backtrace() call loads unwinder and may allocate, which is not
+    // allowed in signal handler.
+    backtrace(_trace.data(), 1);
+
+    g_detector = this;
+    _thread = std::thread([this] { watch(); });
+}
+
+StallDetector::~StallDetector() {
+    {
+        std::lock_guard lock(_mutex);
+        _stop = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+    g_detector = nullptr;
+}
+
+void StallDetector::on_signal(int) noexcept {
+    auto detector = g_detector;
+    if (!detector || detector->_captured.load(std::memory_order_relaxed)) {
+        return;
+    }
+    auto saved_errno = errno;
+    detector->_trace_len = 0;
+    if (detector->_running.load(std::memory_order_relaxed) != 0) {
+        detector->_trace_len = backtrace(detector->_trace.data(), detector->_trace.size());
+    }
+    errno = saved_errno;
+    detector->_captured.store(true, std::memory_order_release);
+}
+
+void StallDetector::watch() {
+    auto period = std::max(_threshold / 4, min_sample_period);
+    std::uint64_t last = 0;
+    auto since = std::chrono::steady_clock::now();
+
+    std::unique_lock lock(_mutex);
+    while (!_cv.wait_for(lock, period, [this] { return _stop; })) {
+        auto now = std::chrono::steady_clock::now();
+        auto running = _running.load(std::memory_order_relaxed);
+        if (running == 0 || running != last) {
+            last = running;
+            since = now;
+            continue;
+        }
+        if (_stalled.load(std::memory_order_relaxed) == running || now - since < _threshold) {
+            continue;
+        }
+        _stalled.store(running, std::memory_order_relaxed);
+        lock.unlock();
+        report(_group.load(std::memory_order_relaxed), now - since);
+        lock.lock();
+    }
+}
+
+void StallDetector::report(unsigned group, std::chrono::nanoseconds running) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - _last_report < report_interval) {
+        ++_suppressed;
+        return;
+    }
+    _last_report = now;
+
+    _captured.store(false, std::memory_order_relaxed);
+    pthread_kill(_reactor_thread, stall_signal());
+    auto deadline = now + capture_timeout;
+    while (!_captured.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    _log.warn("reactor stalled for more than {} us in scheduling group {}",
+        std::chrono::duration_cast<std::chrono::microseconds>(running).count(),
+        group
+    );
+    if (_suppressed > 0) {
+        _log.warn("{} more stalls since last report", std::exchange(_suppressed, 0));
+    }
+    if (_captured.load(std::memory_order_acquire) && _trace_len > 0) {
+        print_stack_trace(_log, std::span<void* const>(_trace.data(), _trace_len));
+    }
+}
+
+} // namespace corey
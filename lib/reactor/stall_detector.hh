@@ -0,0 +1,76 @@
+#pragma once
+
+#include "utils/log.hh"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include <pthread.h>
+
+namespace corey {
+
+// Watchdog for tasks that block reactor thread. Helper thread samples which
+// task is running and, when the same task runs longer than threshold, signals
+// reactor thread to capture its backtrace. Backtraces are logged from helper
+// thread at most once per report_interval, other stalls are only counted.
+class StallDetector {
+public:
+    static constexpr std::chrono::seconds report_interval{1};
+
+    // Must be created on reactor thread.
+    explicit StallDetector(std::chrono::nanoseconds threshold);
+    StallDetector(const StallDetector&) = delete;
+    StallDetector& operator=(const StallDetector&) = delete;
+    StallDetector(StallDetector&&) = delete;
+    StallDetector& operator=(StallDetector&&) = delete;
+    ~StallDetector();
+
+    std::chrono::nanoseconds threshold() const noexcept { return _threshold; }
+
+    void task_started(unsigned group) noexcept {
+        _group.store(group, std::memory_order_relaxed);
+        _running.store(++_seq, std::memory_order_relaxed);
+    }
+
+    // Returns true when finished task was detected as stalled.
+    bool task_finished() noexcept {
+        _running.store(0, std::memory_order_relaxed);
+        return _stalled.load(std::memory_order_relaxed) == _seq;
+    }
+
+private:
+    static void on_signal(int) noexcept;
+
+    void watch();
+    void report(unsigned group, std::chrono::nanoseconds running);
+
+    std::chrono::nanoseconds _threshold;
+    pthread_t _reactor_thread;
+    Log _log;
+
+    // Task sequence number, only touched by reactor thread.
+    std::uint64_t _seq = 0;
+    std::atomic<std::uint64_t> _running = 0;
+    std::atomic<unsigned> _group = 0;
+    std::atomic<std::uint64_t> _stalled = 0;
+
+    // Written by signal handler on reactor thread, read by watchdog.
+    std::array<void*, 32> _trace = {};
+    int _trace_len = 0;
+    std::atomic<bool> _captured = false;
+
+    std::uint64_t _suppressed = 0;
+    std::chrono::steady_clock::time_point _last_report;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _stop = false;
+    std::thread _thread;
+};
+
+} // namespace corey
@@ -1,11 +1,10 @@
 #pragma once
 
-#include <utility>
+#include <cstddef>
 #include <memory>
-#include <span>
-
-#include <boost/intrusive/link_mode.hpp>
-#include <boost/intrusive/list.hpp>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace corey {
 
@@ -15,33 +14,108 @@ struct AbstractExecutable {
 };
 using UPAbstractExecutable = std::unique_ptr<AbstractExecutable>;
 
-using AutoLinkBase = boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink>>;
-
-class Executable : public AutoLinkBase {
+// Small nothrow movable implementations are stored inline, so scheduling
+// a task does not allocate. Larger ones are kept on heap.
+class Executable {
 public:
+    static constexpr std::size_t inline_size = 48;
 
-    Executable() = default;
+    Executable() noexcept = default;
     Executable(const Executable& other) = delete;
     Executable& operator=(const Executable& other) = delete;
-    
-    Executable(Executable&& other) noexcept = default;
-    Executable& operator=(Executable&& other) noexcept = default;
-    ~Executable() = default;
+
+    Executable(Executable&& other) noexcept {
+        take(other);
+    }
+
+    Executable& operator=(Executable&& other) noexcept {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    ~Executable() {
+        reset();
+    }
 
     bool try_execute() {
-        return _model->execute();
+        return _ops->execute(_storage);
     }
 
-    AbstractExecutable& get_impl() noexcept { return *_model; }
+    explicit operator bool() const noexcept { return _ops != nullptr; }
+
+    AbstractExecutable& get_impl() noexcept { return _ops->impl(_storage); }
 
     template<typename Impl, typename... Args>
     static Executable make(Args&&... args) {
-        return Executable(std::make_unique<Impl>(std::forward<Args>(args)...));
+        static_assert(std::is_base_of_v<AbstractExecutable, Impl>, "Impl must implement AbstractExecutable");
+        Executable result;
+        if constexpr (stored_inline<Impl>) {
+            new (result._storage) Impl(std::forward<Args>(args)...);
+            result._ops = &inline_ops<Impl>;
+        } else {
+            new (result._storage) AbstractExecutable*(new Impl(std::forward<Args>(args)...));
+            result._ops = &heap_ops;
+        }
+        return result;
     }
 
 private:
-    explicit Executable(UPAbstractExecutable&& model) noexcept : _model(std::move(model)) {}
-    UPAbstractExecutable _model;
+    struct Ops {
+        bool (*execute)(std::byte*);
+        // Move constructs object in dst and destroys the one in src.
+        void (*relocate)(std::byte* src, std::byte* dst) noexcept;
+        void (*destroy)(std::byte*) noexcept;
+        AbstractExecutable& (*impl)(std::byte*) noexcept;
+    };
+
+    template<typename Impl>
+    static constexpr bool stored_inline = (sizeof(Impl) <= inline_size)
+        && (alignof(std::max_align_t) % alignof(Impl) == 0)
+        && std::is_nothrow_move_constructible_v<Impl>;
+
+    template<typename Impl>
+    static Impl* as(std::byte* storage) noexcept {
+        return std::launder(reinterpret_cast<Impl*>(storage));
+    }
+
+    template<typename Impl>
+    static constexpr Ops inline_ops = {
+        .execute = [](std::byte* storage) { return as<Impl>(storage)->execute(); },
+        .relocate = [](std::byte* src, std::byte* dst) noexcept {
+            new (dst) Impl(std::move(*as<Impl>(src)));
+            as<Impl>(src)->~Impl();
+        },
+        .destroy = [](std::byte* storage) noexcept { as<Impl>(storage)->~Impl(); },
+        .impl = [](std::byte* storage) noexcept -> AbstractExecutable& { return *as<Impl>(storage); },
+    };
+
+    static constexpr Ops heap_ops = {
+        .execute = [](std::byte* storage) { return (*as<AbstractExecutable*>(storage))->execute(); },
+        .relocate = [](std::byte* src, std::byte* dst) noexcept {
+            new (dst) AbstractExecutable*(*as<AbstractExecutable*>(src));
+        },
+        .destroy = [](std::byte* storage) noexcept { delete *as<AbstractExecutable*>(storage); },
+        .impl = [](std::byte* storage) noexcept -> AbstractExecutable& { return **as<AbstractExecutable*>(storage); },
+    };
+
+    void take(Executable& other) noexcept {
+        if (other._ops) {
+            other._ops->relocate(other._storage, _storage);
+            _ops = std::exchange(other._ops, nullptr);
+        }
+    }
+
+    void reset() noexcept {
+        if (_ops) {
+            std::exchange(_ops, nullptr)->destroy(_storage);
+        }
+    }
+
+    const Ops* _ops = nullptr;
+    alignas(std::max_align_t) std::byte _storage[inline_size];
 };
 
 template<typename Func>
@@ -79,17 +153,4 @@ auto make_task(ExeFunc&& exeFunc, IsReadyFunc&& isReadyFunc) {
     );
 }
 
-template<typename Func>
-auto make_routine(Func&& func) {
-    struct SimpleRoutine final : public AbstractExecutable {
-        Func _func;
-        SimpleRoutine(Func&& func) : _func(std::forward<Func>(func)) {}
-        bool execute() override {
-            _func();
-            return false;
-        }
-    };
-    return Executable::make<SimpleRoutine>(std::forward<Func>(func));
-}
-
 } // namespace corey
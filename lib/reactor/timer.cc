@@ -7,14 +7,14 @@
 
 namespace corey {
 
-Future<> sleep(std::chrono::nanoseconds duration) {
+Future<> sleep(std::chrono::nanoseconds duration, AbortSource* abort) {
     timespec now {};
     clock_gettime(CLOCK_MONOTONIC, &now);
     __kernel_timespec ts {
         .tv_sec = now.tv_sec + duration.count() / 1'000'000'000,
         .tv_nsec = now.tv_nsec + duration.count() % 1'000'000'000
     };
-    if (auto result = co_await IoEngine::instance().timeout(&ts); result < 0) {
+    if (auto result = co_await IoEngine::instance().timeout(&ts, abort); result < 0) {
         if (result == -ETIME) {
             co_return;
         }
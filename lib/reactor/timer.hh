@@ -9,6 +9,7 @@ namespace corey {
 
 using namespace std::chrono_literals;
 
-Future<> sleep(std::chrono::nanoseconds);
+// Fails with std::system_error(ECANCELED) when aborted.
+Future<> sleep(std::chrono::nanoseconds, AbortSource* abort = nullptr);
 
 } // namespace corey
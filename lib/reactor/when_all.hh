@@ -0,0 +1,162 @@
+#pragma once
+
+#include "reactor/future.hh"
+#include "reactor/task.hh"
+
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace corey {
+
+template<typename Futures>
+struct WhenAnyResult {
+    // position of the first future that became ready
+    std::size_t index;
+    Futures futures;
+};
+
+namespace when {
+
+template<typename Data, typename Func>
+void for_each_future(std::vector<Future<Data>>& futures, Func&& func) {
+    for (std::size_t idx = 0; idx < futures.size(); ++idx) {
+        func(futures[idx], idx);
+    }
+}
+
+template<typename... Datas, typename Func>
+void for_each_future(std::tuple<Future<Datas>...>& futures, Func&& func) {
+    std::size_t idx = 0;
+    std::apply([&func, &idx](auto&... fut) { (func(fut, idx++), ...); }, futures);
+}
+
+// Waits for all futures with one counter, awaiting side is woken up once.
+template<typename Futures>
+class WhenAll {
+public:
+    static Future<Futures> wait(Futures&& futures) {
+        bool ready = true;
+        for_each_future(futures, [&ready](auto& fut, std::size_t) { ready = ready && fut.is_ready(); });
+        if (ready) {
+            return make_ready_future<Futures>(std::move(futures));
+        }
+
+        auto* self = new WhenAll(std::move(futures));
+        auto result = self->_promise.get_future();
+        for_each_future(self->_futures, [self](auto& fut, std::size_t) {
+            if (!fut.is_ready()) {
+                ++self->_pending;
+                fut.set_inline_continuation(make_task([self] { self->complete(); }));
+            }
+        });
+        self->complete();
+        return result;
+    }
+
+private:
+    explicit WhenAll(Futures&& futures) : _futures(std::move(futures)) {}
+
+    void complete() {
+        if (--_pending == 0) {
+            _promise.set(std::move(_futures));
+            delete this;
+        }
+    }
+
+    Futures _futures;
+    Promise<Futures> _promise;
+    // not ready futures, plus one while continuations are being set
+    std::size_t _pending = 1;
+};
+
+// Completes when first future becomes ready, continuations left on other
+// futures are dropped, so they can be awaited again. Dropping result future
+// drops them too, otherwise inputs which never become ready would keep
+// WhenAny alive.
+template<typename Futures>
+class WhenAny final : public AbstractExecutable {
+public:
+    static Future<WhenAnyResult<Futures>> wait(Futures&& futures) {
+        std::size_t ready = npos;
+        for_each_future(futures, [&ready](auto& fut, std::size_t idx) {
+            if ((ready == npos) && fut.is_ready()) {
+                ready = idx;
+            }
+        });
+        if (ready != npos) {
+            return make_ready_future<WhenAnyResult<Futures>>(WhenAnyResult<Futures>{ ready, std::move(futures) });
+        }
+
+        auto* self = new WhenAny(std::move(futures));
+        auto result = self->_promise.get_future();
+        for_each_future(self->_futures, [self](auto& fut, std::size_t idx) {
+            fut.set_inline_continuation(make_task([self, idx] { self->complete(idx); }));
+        });
+        self->_promise.set_abandon_handler(self);
+        return result;
+    }
+
+    // Result future was dropped.
+    bool execute() override {
+        release(npos);
+        delete this;
+        return true;
+    }
+
+private:
+    static constexpr std::size_t npos = ~std::size_t(0);
+
+    explicit WhenAny(Futures&& futures) : _futures(std::move(futures)) {}
+
+    void release(std::size_t index) noexcept {
+        for_each_future(_futures, [index](auto& fut, std::size_t idx) {
+            if (idx != index) {
+                fut.reset_continuation();
+            }
+        });
+    }
+
+    void complete(std::size_t index) {
+        release(index);
+        _promise.set_abandon_handler(nullptr);
+        _promise.set(WhenAnyResult<Futures>{ index, std::move(_futures) });
+        delete this;
+    }
+
+    Futures _futures;
+    Promise<WhenAnyResult<Futures>> _promise;
+};
+
+} // namespace when
+
+// Resolves when all futures are ready, futures are returned in the same
+// order with their results or exceptions.
+template<typename Data>
+Future<std::vector<Future<Data>>> when_all(std::vector<Future<Data>>&& futures) {
+    return when::WhenAll<std::vector<Future<Data>>>::wait(std::move(futures));
+}
+
+template<typename... Datas>
+Future<std::tuple<Future<Datas>...>> when_all(Future<Datas>&&... futures) {
+    return when::WhenAll<std::tuple<Future<Datas>...>>::wait(std::make_tuple(std::move(futures)...));
+}
+
+// Resolves when any of futures is ready.
+template<typename Data>
+Future<WhenAnyResult<std::vector<Future<Data>>>> when_any(std::vector<Future<Data>>&& futures) {
+    if (futures.empty()) {
+        throw std::invalid_argument("when_any requires at least one future");
+    }
+    return when::WhenAny<std::vector<Future<Data>>>::wait(std::move(futures));
+}
+
+template<typename... Datas>
+requires (sizeof...(Datas) > 0)
+Future<WhenAnyResult<std::tuple<Future<Datas>...>>> when_any(Future<Datas>&&... futures) {
+    return when::WhenAny<std::tuple<Future<Datas>...>>::wait(std::make_tuple(std::move(futures)...));
+}
+
+} // namespace corey
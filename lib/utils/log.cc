@@ -73,17 +73,21 @@ void Log::put(Log::Level level, std::string_view text) const {
     sink.write(fmt::format("[{}][{}] {}: {}\n", std::chrono::system_clock::now(), level, this->name, text));
 }
 
-void print_stack_trace(Log& log) {
+void print_stack_trace(Log& log, std::span<void* const> trace) {
     constexpr auto separator = "\n    ";
-    constexpr auto trace_size = 32;
-    void* trace[trace_size] = {};
-    auto trace_len = backtrace(trace, trace_size);
     log.error("stack trace: {}{}",
         separator,
-        fmt::join(trace, trace + trace_len, separator)
+        fmt::join(trace.begin(), trace.end(), separator)
     );
 }
 
+void print_stack_trace(Log& log) {
+    constexpr auto trace_size = 32;
+    void* trace[trace_size] = {};
+    auto trace_len = backtrace(trace, trace_size);
+    print_stack_trace(log, std::span<void* const>(trace, trace_len));
+}
+
 void log_orphaned_exception(std::exception_ptr exp) {
     Log log("orphan", Log::get_default_sink());
     try {
@@ -5,6 +5,7 @@
 
 #include <fmt/core.h>
 
+#include <span>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -81,6 +82,11 @@ private:
 
 void log_orphaned_exception(std::exception_ptr);
 
+// Logs trace captured with backtrace(3) as error.
+void print_stack_trace(Log&, std::span<void* const> trace);
+// Logs backtrace of the calling thread as error.
+void print_stack_trace(Log&);
+
 } // namespace corey
 
 template<>
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace corey {
+
+// Value or error code. Lets errors flow as values on hot paths, where
+// throwing and rethrowing exceptions is too expensive.
+template<typename Data = void>
+class [[nodiscard]] Result {
+public:
+
+    Result(Data value) : _storage(std::in_place_index<0>, std::move(value)) {}
+    Result(std::error_code error) noexcept : _storage(std::in_place_index<1>, error) {}
+
+    bool has_value() const noexcept { return _storage.index() == 0; }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    std::error_code error() const noexcept {
+        return has_value() ? std::error_code() : std::get<1>(_storage);
+    }
+
+    // Throws std::system_error if result holds error.
+    Data& value() & {
+        check();
+        return std::get<0>(_storage);
+    }
+
+    Data&& value() && {
+        check();
+        return std::get<0>(std::move(_storage));
+    }
+
+    Data& operator*() & noexcept { return *std::get_if<0>(&_storage); }
+    Data&& operator*() && noexcept { return std::move(*std::get_if<0>(&_storage)); }
+    Data* operator->() noexcept { return std::get_if<0>(&_storage); }
+
+private:
+    void check() const {
+        if (!has_value()) {
+            throw std::system_error(std::get<1>(_storage));
+        }
+    }
+
+    std::variant<Data, std::error_code> _storage;
+};
+
+template<>
+class [[nodiscard]] Result<void> {
+public:
+
+    Result() noexcept = default;
+    Result(std::error_code error) noexcept : _error(error) {}
+
+    bool has_value() const noexcept { return !_error; }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    std::error_code error() const noexcept { return _error; }
+
+    void value() const {
+        if (_error) {
+            throw std::system_error(_error);
+        }
+    }
+
+private:
+    std::error_code _error;
+};
+
+// Bridge to exception based API: returns value, error is thrown as
+// std::system_error with given message.
+template<typename Data>
+Data value_or_throw(Result<Data>&& result, const char* what) {
+    if (!result) {
+        throw std::system_error(result.error(), what);
+    }
+    if constexpr (!std::is_void_v<Data>) {
+        return std::move(*result);
+    }
+}
+
+} // namespace corey
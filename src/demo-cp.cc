@@ -2,6 +2,24 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <span>
+
+// Reads file sequentially into buffer, next chunk is read only after
+// previous one was consumed.
+corey::AsyncGenerator<std::span<const char>> read_chunks(const corey::File& input, std::span<char> buffer) {
+    uint64_t cursor = 0;
+    while (true) {
+        auto size = co_await input.read(cursor, buffer);
+        if (size == 0) {
+            co_return;
+        }
+        co_yield std::span<const char>(buffer.data(), size);
+        if (size < buffer.size()) {
+            co_return;
+        }
+        cursor += size;
+    }
+}
 
 int main(int argc, char* argv[]) {
     using namespace corey;
@@ -35,16 +53,14 @@ int main(int argc, char* argv[]) {
         std::exception_ptr eptr;
         try {
             uint64_t cursor = 0;
-            std::vector<Future<uint64_t>> futures;
-            while (true) {
-                char buf[4096];
-                auto read_bytes = co_await input.read(cursor, std::span(buf, sizeof(buf)));
-                auto written_bytes = co_await output.write(cursor, std::span(buf, read_bytes));
-                if (read_bytes != written_bytes) {
+            char buf[4096];
+            auto chunks = read_chunks(input, std::span(buf, sizeof(buf)));
+            while (auto* chunk = co_await chunks.next()) {
+                auto written_bytes = co_await output.write(cursor, *chunk);
+                if (written_bytes != chunk->size()) {
                     co_await std::make_exception_ptr(std::runtime_error("write failed"));
                 }
-                if (read_bytes < sizeof(buf)) { break; }
-                cursor += read_bytes;
+                cursor += written_bytes;
             }
         } catch (...) {
             eptr = std::current_exception();
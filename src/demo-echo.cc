@@ -49,10 +49,10 @@ int main(int argc, char* argv[]) {
             logger.info("Listening on port {}", port);
 
             uint64_t client_id = 0;
-            while (true) {
-                auto client = co_await listener.accept();
+            auto clients = listener.clients();
+            while (auto* client = co_await clients.next()) {
                 logger.info("New connection accepted");
-                std::ignore = echo(client_id++, std::move(client));
+                std::ignore = echo(client_id++, std::move(*client));
             }
         } catch (...) {
             eptr = std::current_exception();
@@ -0,0 +1,43 @@
+#include "reactor/future.hh"
+
+#include <gtest/gtest.h>
+#include <fmt/core.h>
+
+#include <chrono>
+#include <cstdint>
+
+namespace {
+
+constexpr int future_passes = 1'000'000;
+
+template<typename Func>
+double measure_ns_per_op(Func&& func) {
+    std::int64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < future_passes; ++i) {
+        sum += func(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    EXPECT_EQ(sum, std::int64_t(future_passes) * (future_passes - 1) / 2);
+    return std::chrono::duration<double, std::nano>(end - start).count() / future_passes;
+}
+
+} // namespace
+
+// Compares cost of creating and consuming one future:
+//  - ready: make_ready_future, result is kept inline
+//  - pending: future retrieved from promise, then promise is set
+TEST(FutureBench, ReadyVersusPendingFuture) {
+    auto ready = measure_ns_per_op([](int value) {
+        auto fut = corey::make_ready_future<int>(value);
+        return fut.get();
+    });
+    auto pending = measure_ns_per_op([](int value) {
+        corey::Promise<int> promise;
+        auto fut = promise.get_future();
+        promise.set(value);
+        return fut.get();
+    });
+    fmt::print("{:>16} {:>16}\n", "ready ns/op", "pending ns/op");
+    fmt::print("{:>16.1f} {:>16.1f}\n", ready, pending);
+}
@@ -0,0 +1,117 @@
+#include "reactor/coroutine.hh"
+#include "reactor/future.hh"
+#include "reactor/reactor.hh"
+#include "reactor/io/io.hh"
+#include "reactor/io/socket.hh"
+
+#include <gtest/gtest.h>
+#include <fmt/core.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr uint16_t echo_port = 55315;
+constexpr int echo_connections = 16;
+constexpr int echo_round_trips = 2'000;
+constexpr std::size_t echo_message = 64;
+
+struct EchoResult {
+    double ops_per_sec;
+    double syscalls_per_op;
+    unsigned setup_flags;
+};
+
+corey::Future<> echo(corey::Client client) {
+    std::array<char, echo_message> buffer;
+    while (auto size = co_await client.read(buffer)) {
+        co_await client.write(std::span(buffer.data(), size));
+    }
+    co_await client.close();
+}
+
+corey::Future<> serve(corey::Server& listener) {
+    std::vector<corey::Future<>> echoes;
+    for (int i = 0; i < echo_connections; ++i) {
+        echoes.push_back(echo(co_await listener.accept()));
+    }
+    for (auto& fut : echoes) {
+        co_await std::move(fut);
+    }
+}
+
+corey::Future<> ping(uint16_t port) {
+    auto client = co_await corey::Socket::make_tcp_connect("127.0.0.1", port);
+    std::array<char, echo_message> buffer{};
+    for (int i = 0; i < echo_round_trips; ++i) {
+        co_await client.write(buffer);
+        std::size_t received = 0;
+        while (received < buffer.size()) {
+            received += co_await client.read(std::span(buffer).subspan(received));
+        }
+    }
+    co_await client.close();
+}
+
+template<typename Data>
+Data run_until_ready(corey::Reactor& reactor, corey::Future<Data>&& fut) {
+    while (!fut.is_ready()) {
+        reactor.run();
+    }
+    return fut.get();
+}
+
+// Round trips of echo_connections clients served by echo server, both
+// running on one reactor which polls instead of sleeping.
+EchoResult run_echo(const corey::IoEngineConfig& config, uint16_t port) {
+    corey::Reactor reactor;
+    corey::IoEngine engine(reactor, config);
+    reactor.set_idle_policy(corey::IdlePolicy::poll);
+
+    auto listener = run_until_ready(reactor, corey::Socket::make_tcp_listener(port));
+    auto server = serve(listener);
+    auto before = engine.stats();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<corey::Future<>> clients;
+    for (int i = 0; i < echo_connections; ++i) {
+        clients.push_back(ping(port));
+    }
+    for (auto& client : clients) {
+        run_until_ready(reactor, std::move(client));
+    }
+    auto end = std::chrono::steady_clock::now();
+    auto after = engine.stats();
+    run_until_ready(reactor, std::move(server));
+    run_until_ready(reactor, listener.close());
+
+    double ops = double(echo_connections) * echo_round_trips;
+    auto syscalls = (after.submit_syscalls - before.submit_syscalls) + (after.wait_syscalls - before.wait_syscalls);
+    return EchoResult{
+        .ops_per_sec = ops / std::chrono::duration<double>(end - start).count(),
+        .syscalls_per_op = double(syscalls) / ops,
+        .setup_flags = engine.setup_flags(),
+    };
+}
+
+} // namespace
+
+// Compares echo round trips with requests submitted by io_uring_enter and
+// by SQ thread. SQ thread may be refused by kernel, then both rows match.
+TEST(IoBench, EchoWithAndWithoutSqPoll) {
+    fmt::print("{:>10} {:>16} {:>16}\n", "sqpoll", "round trips/s", "syscalls/op");
+    auto plain = run_echo({}, echo_port);
+    fmt::print("{:>10} {:>16.0f} {:>16.3f}\n", "off", plain.ops_per_sec, plain.syscalls_per_op);
+    // polling reactor and SQ thread sharing single cpu only measure scheduler
+    if (std::thread::hardware_concurrency() < 2) {
+        fmt::print("{:>10} {:>16} {:>16}\n", "skipped", "-", "-");
+        return;
+    }
+    auto polled = run_echo({ .sq_poll = true, .sq_thread_idle = std::chrono::milliseconds(100) }, echo_port + 1);
+    auto enabled = (polled.setup_flags & IORING_SETUP_SQPOLL) ? "on" : "refused";
+    fmt::print("{:>10} {:>16.0f} {:>16.3f}\n", enabled, polled.ops_per_sec, polled.syscalls_per_op);
+}
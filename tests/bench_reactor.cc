@@ -0,0 +1,77 @@
+#include "reactor/coroutine.hh"
+#include "reactor/future.hh"
+#include "reactor/reactor.hh"
+#include "reactor/task.hh"
+
+#include <gtest/gtest.h>
+#include <fmt/core.h>
+
+#include <chrono>
+#include <vector>
+
+namespace {
+
+constexpr int loop_passes = 100;
+
+template<typename Func>
+std::chrono::nanoseconds measure_loop(corey::Reactor& reactor, Func&& func) {
+    func();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < loop_passes; ++i) {
+        reactor.run();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return (end - start) / loop_passes;
+}
+
+corey::Future<> parked(corey::Future<> fut) {
+    co_await std::move(fut);
+}
+
+} // namespace
+
+// Compares cost of one Reactor::run pass with N idle waiters:
+//  - polled: waiter is re-checked on every pass (how await worked before)
+//  - parked: waiter is scheduled only when promise is set
+TEST(ReactorBench, IdleLoopWithParkedCoroutines) {
+    fmt::print("{:>10} {:>16} {:>16}\n", "waiters", "polled ns/pass", "parked ns/pass");
+    for (auto count: {1, 1'000, 100'000}) {
+        std::chrono::nanoseconds polled;
+        {
+            corey::Reactor reactor;
+            bool ready = false;
+            polled = measure_loop(reactor, [&]{
+                for (int i = 0; i < count; ++i) {
+                    reactor.add_task(corey::make_task([]{}, [&ready]{ return ready; }));
+                }
+            });
+            ready = true;
+            while (reactor.has_progress()) {
+                reactor.run();
+            }
+        }
+
+        std::chrono::nanoseconds event;
+        {
+            corey::Reactor reactor;
+            std::vector<corey::Promise<>> promises(count);
+            std::vector<corey::Future<>> waiters;
+            waiters.reserve(count);
+            event = measure_loop(reactor, [&]{
+                for (auto& promise: promises) {
+                    waiters.push_back(parked(promise.get_future()));
+                }
+            });
+            for (auto& promise: promises) {
+                promise.set();
+            }
+            while (reactor.has_progress()) {
+                reactor.run();
+            }
+            for (auto& waiter: waiters) {
+                EXPECT_TRUE(waiter.is_ready());
+            }
+        }
+        fmt::print("{:>10} {:>16} {:>16}\n", count, polled.count(), event.count());
+    }
+}
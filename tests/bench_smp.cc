@@ -0,0 +1,39 @@
+#include "corey.hh"
+
+#include <gtest/gtest.h>
+#include <fmt/core.h>
+
+#include <chrono>
+#include <vector>
+
+TEST(SmpBench, SubmitToBurst) {
+    char* args[] = {
+        const_cast<char*>("bench"),
+        const_cast<char*>("--smp=2")
+    };
+    corey::Application app(std::extent_v<decltype(args)>, args);
+
+    app.run([](const corey::ParseResult&) -> corey::Future<int> {
+        fmt::print("{:>10} {:>16} {:>16}\n", "burst", "total us", "ns/message");
+        for (auto burst: {1, 1'000, 100'000}) {
+            std::vector<corey::Future<int>> replies;
+            replies.reserve(burst);
+
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < burst; ++i) {
+                replies.push_back(corey::submit_to(1, [i] { return i; }));
+            }
+            for (auto& reply: replies) {
+                std::ignore = co_await std::move(reply);
+            }
+            auto elapsed = std::chrono::steady_clock::now() - start;
+
+            fmt::print("{:>10} {:>16} {:>16}\n",
+                burst,
+                std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(),
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / burst
+            );
+        }
+        co_return 0;
+    });
+}
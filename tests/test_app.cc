@@ -3,7 +3,7 @@
 
 #include "corey.hh"
 
-class SocketTest : public testing::Test {
+class AppTest : public testing::Test {
 protected:
     void SetUp() override {}
 
@@ -12,14 +12,14 @@ protected:
     corey::Application app{0, nullptr};
 };
 
-TEST_F(SocketTest, Run) {
+TEST_F(AppTest, Run) {
     auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
         co_return 42;
     });
     EXPECT_EQ(result, 42);
 }
 
-TEST_F(SocketTest, RunWithException) {
+TEST_F(AppTest, RunWithException) {
     try {
         app.run([](const corey::ParseResult&) -> corey::Future<int> {
             throw std::runtime_error("Exception");
@@ -30,7 +30,7 @@ TEST_F(SocketTest, RunWithException) {
     }
 }
 
-TEST_F(SocketTest, RunReadFromZero) {
+TEST_F(AppTest, RunReadFromZero) {
     auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
         auto file = co_await corey::File::open("/dev/zero", O_RDONLY);
         std::array<char, 100> data;
@@ -46,7 +46,7 @@ TEST_F(SocketTest, RunReadFromZero) {
     EXPECT_EQ(result, 0);
 }
 
-TEST_F(SocketTest, RunWriteToNull) {
+TEST_F(AppTest, RunWriteToNull) {
     auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
         auto file = co_await corey::File::open("/dev/null", O_WRONLY);
         std::array<char, 100> data;
@@ -60,7 +60,7 @@ TEST_F(SocketTest, RunWriteToNull) {
     EXPECT_EQ(result, 0);
 }
 
-TEST_F(SocketTest, RunReadFromNonExistent) {
+TEST_F(AppTest, RunReadFromNonExistent) {
     try {
         app.run([](const corey::ParseResult&) -> corey::Future<int> {
             auto file = co_await corey::File::open("/nonexistent", O_RDONLY);
@@ -74,7 +74,7 @@ TEST_F(SocketTest, RunReadFromNonExistent) {
     }
 }
 
-TEST_F(SocketTest, RunWriteToReadOnly) {
+TEST_F(AppTest, RunWriteToReadOnly) {
     app.run([](const corey::ParseResult&) -> corey::Future<int> {
         auto file = co_await corey::File::open("/dev/zero", O_RDONLY);
         std::array<char, 100> data;
@@ -91,7 +91,7 @@ TEST_F(SocketTest, RunWriteToReadOnly) {
     });
 }
 
-TEST_F(SocketTest, RunFileFsync) {
+TEST_F(AppTest, RunFileFsync) {
     auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
         auto file = co_await corey::File::open("/dev/zero", O_RDONLY);
         try {
@@ -105,7 +105,7 @@ TEST_F(SocketTest, RunFileFsync) {
     EXPECT_EQ(result, 0);
 }
 
-TEST_F(SocketTest, RunFileFdatasync) {
+TEST_F(AppTest, RunFileFdatasync) {
     auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
         auto file = co_await corey::File::open("/dev/zero", O_RDONLY);
         try {
@@ -119,7 +119,7 @@ TEST_F(SocketTest, RunFileFdatasync) {
     EXPECT_EQ(result, 0);
 }
 
-TEST_F(SocketTest, RunFileMoveAssignmentOperator) {
+TEST_F(AppTest, RunFileMoveAssignmentOperator) {
     auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
         auto file = co_await corey::File::open("/dev/zero", O_RDONLY);
         corey::File file2;
@@ -131,7 +131,7 @@ TEST_F(SocketTest, RunFileMoveAssignmentOperator) {
     EXPECT_EQ(result, 0);
 }
 
-TEST_F(SocketTest, RunYield) {
+TEST_F(AppTest, RunYield) {
     auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
         co_await corey::yield();
         co_return 42;
@@ -351,3 +351,37 @@ TEST(Application, CheckSleepNegativeTimeout) {
         EXPECT_EQ(e.code().value(), EINVAL);
     }
 }
+
+TEST(Application, ShutdownCancelsPendingSleep) {
+    using namespace std::chrono_literals;
+
+    bool cancelled = false;
+    {
+        corey::Application app(0, nullptr);
+        auto result = app.run([&cancelled](const corey::ParseResult&) -> corey::Future<int> {
+            // detached, still sleeping when main returns
+            std::ignore = [](bool& cancelled) -> corey::Future<> {
+                try {
+                    co_await corey::sleep(1h);
+                } catch (const std::system_error& e) {
+                    cancelled = e.code().value() == ECANCELED;
+                }
+            }(cancelled);
+            co_return 0;
+        });
+        EXPECT_EQ(result, 0);
+        EXPECT_FALSE(cancelled);
+    }
+    EXPECT_TRUE(cancelled);
+}
+
+TEST(Application, LocalServiceFailure) {
+    corey::Application app(0, nullptr);
+    app.add_shard_service([](const corey::ParseResult&) -> corey::Future<> {
+        throw std::runtime_error("service failed");
+        co_return;
+    });
+    EXPECT_THROW({
+        app.run([](const corey::ParseResult&) -> corey::Future<int> { co_return 0; });
+    }, std::runtime_error);
+}
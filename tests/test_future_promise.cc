@@ -1,8 +1,13 @@
 #include "reactor/future.hh"
+#include "reactor/when_all.hh"
 
 #include <gtest/gtest.h>
+#include <cstdint>
+#include <optional>
 #include <stdexcept>
+#include <string>
 #include <tuple>
+#include <vector>
 
 TEST(PromiseFutureTest, CheckFutureExceptionWhatText) {
     auto broken_promise = corey::BrokenPromise();
@@ -303,3 +308,171 @@ TEST(PromiseFutureTest, MakeFutureVoidMove) {
 
     EXPECT_NO_THROW({ fut2.get(); });
 }
+
+TEST(PromiseFutureTest, MakeReadyFutureNonCopyable) {
+    auto fut = corey::make_ready_future<std::unique_ptr<MyClass>>(std::make_unique<MyClass>(42));
+    auto fut2 = std::move(fut);
+
+    EXPECT_TRUE(fut2.is_ready());
+    EXPECT_FALSE(fut2.has_failed());
+    EXPECT_FALSE(fut2.get_exception());
+
+    std::unique_ptr<MyClass> result = fut2.get();
+    EXPECT_EQ(result->getValue(), 42);
+}
+
+TEST(PromiseFutureTest, ThenOnReadyFuture) {
+    auto fut = corey::make_ready_future<int>(20).then([](int value) {
+        return static_cast<uint64_t>(value) * 2 + 2;
+    });
+
+    EXPECT_TRUE(fut.is_ready());
+    EXPECT_EQ(fut.get(), 42u);
+}
+
+TEST(PromiseFutureTest, ThenRunsWhenPromiseSet) {
+    corey::Promise<int> test;
+    bool called = false;
+
+    corey::Future<> fut = test.get_future().then([&called](int value) {
+        called = (value == 42);
+    });
+    EXPECT_FALSE(fut.is_ready());
+    EXPECT_FALSE(called);
+
+    test.set(42);
+    EXPECT_TRUE(called);
+    EXPECT_TRUE(fut.is_ready());
+    EXPECT_FALSE(fut.has_failed());
+}
+
+TEST(PromiseFutureTest, ThenUnwrapsFuture) {
+    corey::Promise<int> first;
+    corey::Promise<std::string> second;
+
+    auto fut = first.get_future().then([&second](int) {
+        return second.get_future();
+    });
+    first.set(1);
+    EXPECT_FALSE(fut.is_ready());
+
+    second.set("done");
+    EXPECT_TRUE(fut.is_ready());
+    EXPECT_EQ(fut.get(), "done");
+}
+
+TEST(PromiseFutureTest, ThenSkippedOnException) {
+    corey::Promise<int> test;
+    bool called = false;
+    bool finished = false;
+
+    auto fut = test.get_future()
+        .then([&called](int value) {
+            called = true;
+            return value;
+        })
+        .handle_exception([](std::exception_ptr exp) {
+            EXPECT_THROW(std::rethrow_exception(exp), std::runtime_error);
+            return -1;
+        })
+        .finally([&finished] { finished = true; });
+
+    test.set_exception(std::make_exception_ptr(std::runtime_error("test")));
+    EXPECT_FALSE(called);
+    EXPECT_TRUE(finished);
+    EXPECT_EQ(fut.get(), -1);
+}
+
+TEST(PromiseFutureTest, ThenThrowFailsFuture) {
+    auto fut = corey::make_ready_future<>().then([]() -> int {
+        throw std::runtime_error("test");
+    });
+
+    EXPECT_TRUE(fut.has_failed());
+    EXPECT_THROW({ std::ignore = fut.get(); }, std::runtime_error);
+}
+
+TEST(PromiseFutureTest, BrokenPromiseReachesThen) {
+    std::optional<corey::Future<int>> fut;
+    {
+        corey::Promise<int> test;
+        fut = test.get_future().then([](int value) { return value; });
+    }
+
+    EXPECT_TRUE(fut->has_failed());
+    EXPECT_THROW({ std::ignore = fut->get(); }, corey::BrokenPromise);
+}
+
+TEST(PromiseFutureTest, WhenAllKeepsOrder) {
+    std::vector<corey::Promise<int>> promises(3);
+    std::vector<corey::Future<int>> futures;
+    for (auto& promise: promises) {
+        futures.push_back(promise.get_future());
+    }
+    futures.push_back(corey::make_ready_future<int>(3));
+
+    auto all = corey::when_all(std::move(futures));
+    promises[2].set(2);
+    promises[0].set(0);
+    EXPECT_FALSE(all.is_ready());
+
+    promises[1].set_exception(std::make_exception_ptr(std::runtime_error("test")));
+    EXPECT_TRUE(all.is_ready());
+
+    auto results = all.get();
+    ASSERT_EQ(results.size(), 4u);
+    EXPECT_EQ(results[0].get(), 0);
+    EXPECT_THROW({ std::ignore = results[1].get(); }, std::runtime_error);
+    EXPECT_EQ(results[2].get(), 2);
+    EXPECT_EQ(results[3].get(), 3);
+}
+
+TEST(PromiseFutureTest, WhenAllVariadic) {
+    corey::Promise<std::string> promise;
+
+    auto all = corey::when_all(corey::make_ready_future<int>(1), promise.get_future(), corey::make_ready_future<>());
+    EXPECT_FALSE(all.is_ready());
+
+    promise.set("two");
+    auto [first, second, third] = all.get();
+    EXPECT_EQ(first.get(), 1);
+    EXPECT_EQ(second.get(), "two");
+    EXPECT_NO_THROW(third.get());
+
+    auto empty = corey::when_all(std::vector<corey::Future<int>>());
+    EXPECT_TRUE(empty.is_ready());
+    EXPECT_TRUE(empty.get().empty());
+}
+
+TEST(PromiseFutureTest, WhenAnyReleasesOtherFutures) {
+    corey::Promise<int> first;
+    corey::Promise<> second;
+
+    auto any = corey::when_any(first.get_future(), second.get_future());
+    EXPECT_FALSE(any.is_ready());
+
+    second.set();
+    EXPECT_TRUE(any.is_ready());
+    auto result = any.get();
+    EXPECT_EQ(result.index, 1u);
+
+    auto& [rest, done] = result.futures;
+    EXPECT_TRUE(done.is_ready());
+    auto next = std::move(rest).then([](int value) { return value + 1; });
+    first.set(41);
+    EXPECT_EQ(next.get(), 42);
+
+    EXPECT_THROW({ std::ignore = corey::when_any(std::vector<corey::Future<int>>()); }, std::invalid_argument);
+}
+
+TEST(PromiseFutureTest, WhenAnyDroppedResultReleasesInputs) {
+    corey::Promise<int> first;
+    corey::Promise<> second;
+
+    std::ignore = corey::when_any(first.get_future(), second.get_future());
+    EXPECT_FALSE(first.has_future());
+    EXPECT_FALSE(second.has_future());
+
+    first.set(1);
+    second.set();
+}
@@ -1,11 +1,27 @@
+#include "reactor/abort_source.hh"
+#include "reactor/coroutine.hh"
+#include "reactor/frame_allocator.hh"
 #include "reactor/future.hh"
 #include "reactor/reactor.hh"
 #include "reactor/io/io.hh"
 #include "reactor/task.hh"
+#include "reactor/timer.hh"
+#include "reactor/when_all.hh"
 
+#include <algorithm>
 #include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 #include <memory>
+#include <optional>
+#include <span>
+#include <system_error>
+
+#include <unistd.h>
 
 #include <gtest/gtest.h>
 
@@ -28,6 +44,523 @@ TEST(ReactorTest, ReactorAdd) {
     EXPECT_EQ(fut.get(), 101);
 }
 
+TEST(ReactorTest, ReactorWakeOnPromiseSet) {
+    corey::Reactor reactor;
+    corey::Promise<int> promise;
+    int result = 0;
+
+    auto coro = [](corey::Future<int> fut, int& result) -> corey::Future<> {
+        result = co_await std::move(fut);
+    }(promise.get_future(), result);
+
+    EXPECT_FALSE(reactor.has_progress());
+    reactor.run();
+    EXPECT_FALSE(coro.is_ready());
+
+    promise.set(42);
+    EXPECT_TRUE(reactor.has_progress());
+    reactor.run();
+
+    EXPECT_TRUE(coro.is_ready());
+    EXPECT_FALSE(reactor.has_progress());
+    EXPECT_EQ(result, 42);
+}
+
+TEST(ReactorTest, ReactorYieldRunsOncePerPass) {
+    corey::Reactor reactor;
+    int passes = 0;
+
+    auto coro = [](int& passes) -> corey::Future<> {
+        for (int i = 0; i < 3; ++i) {
+            ++passes;
+            co_await corey::yield();
+        }
+    }(passes);
+
+    EXPECT_EQ(passes, 1);
+    reactor.run();
+    EXPECT_EQ(passes, 2);
+    reactor.run();
+    EXPECT_EQ(passes, 3);
+    reactor.run();
+    EXPECT_TRUE(coro.is_ready());
+}
+
+namespace {
+
+corey::Future<int> await_nested(corey::Future<int> fut, int depth) {
+    if (depth == 0) {
+        co_return co_await std::move(fut);
+    }
+    co_return co_await await_nested(std::move(fut), depth - 1) + 1;
+}
+
+} // namespace
+
+TEST(ReactorTest, NestedAwaitsResumeInOnePass) {
+    corey::Reactor reactor;
+    corey::Promise<int> promise;
+
+    auto root = await_nested(promise.get_future(), 5);
+    reactor.run();
+    EXPECT_FALSE(root.is_ready());
+
+    promise.set(1);
+    reactor.run();
+    EXPECT_TRUE(root.is_ready());
+    EXPECT_FALSE(reactor.has_progress());
+    EXPECT_EQ(root.get(), 6);
+}
+
+TEST(ReactorTest, NestedAwaitInOtherGroupIsScheduled) {
+    corey::Reactor reactor;
+    corey::Promise<int> promise;
+    auto bg = reactor.create_scheduling_group("bg", 100);
+
+    auto inner = await_nested(promise.get_future(), 0);
+    auto outer = corey::with_scheduling_group(bg, [&inner] {
+        return [](corey::Future<int> fut) -> corey::Future<int> {
+            co_return co_await std::move(fut) + 1;
+        }(std::move(inner));
+    });
+
+    promise.set(1);
+    reactor.run();
+    EXPECT_FALSE(outer.is_ready());
+    reactor.run();
+    EXPECT_TRUE(outer.is_ready());
+    EXPECT_EQ(outer.get(), 2);
+    EXPECT_EQ(bg.stats().tasks_run, 1u);
+}
+
+TEST(ReactorTest, TaskStartsWhenAwaited) {
+    corey::Reactor reactor;
+    corey::Promise<int> promise;
+    bool started = false;
+
+    auto task = [](corey::Future<int> fut, bool& started) -> corey::Task<int> {
+        started = true;
+        co_return co_await std::move(fut) + 1;
+    }(promise.get_future(), started);
+    EXPECT_FALSE(started);
+
+    auto result = [](corey::Task<int> task) -> corey::Future<int> {
+        co_return co_await std::move(task) * 2;
+    }(std::move(task));
+    EXPECT_TRUE(started);
+    EXPECT_FALSE(result.is_ready());
+
+    promise.set(20);
+    reactor.run();
+    EXPECT_TRUE(result.is_ready());
+    EXPECT_EQ(result.get(), 42);
+}
+
+TEST(ReactorTest, TaskConvertsToFuture) {
+    corey::Reactor reactor;
+
+    corey::Future<> failed = []() -> corey::Task<> {
+        co_await std::make_exception_ptr(std::runtime_error("task failed"));
+    }();
+    EXPECT_TRUE(failed.is_ready());
+    EXPECT_THROW(failed.get(), std::runtime_error);
+
+    auto value = []() -> corey::Task<std::string> {
+        co_await corey::yield();
+        co_return "done";
+    }().to_future();
+    EXPECT_FALSE(value.is_ready());
+    reactor.run();
+    EXPECT_TRUE(value.is_ready());
+    EXPECT_EQ(value.get(), "done");
+}
+
+TEST(ReactorTest, GeneratorDoesNotRunAhead) {
+    corey::Reactor reactor;
+    corey::Promise<int> promise;
+    int produced = 0;
+
+    auto gen = [](corey::Future<int> fut, int& produced) -> corey::AsyncGenerator<int> {
+        for (int i = 0; i < 3; ++i) {
+            ++produced;
+            co_yield i;
+        }
+        ++produced;
+        co_yield co_await std::move(fut);
+    }(promise.get_future(), produced);
+    EXPECT_EQ(produced, 0);
+
+    std::vector<int> consumed;
+    auto done = [](corey::AsyncGenerator<int>& gen, std::vector<int>& consumed, int& produced) -> corey::Future<> {
+        while (auto* item = co_await gen.next()) {
+            consumed.push_back(*item);
+            EXPECT_EQ(produced, int(consumed.size()));
+        }
+    }(gen, consumed, produced);
+    EXPECT_EQ(consumed, std::vector<int>({ 0, 1, 2 }));
+    EXPECT_FALSE(done.is_ready());
+
+    promise.set(3);
+    reactor.run();
+    EXPECT_TRUE(done.is_ready());
+    EXPECT_EQ(consumed, std::vector<int>({ 0, 1, 2, 3 }));
+}
+
+TEST(ReactorTest, GeneratorRethrowsException) {
+    corey::Reactor reactor;
+
+    auto gen = []() -> corey::AsyncGenerator<std::string> {
+        co_yield "first";
+        co_await std::make_exception_ptr(std::runtime_error("producer failed"));
+    }();
+
+    auto result = [](corey::AsyncGenerator<std::string> gen) -> corey::Future<std::string> {
+        std::string first = *co_await gen.next();
+        EXPECT_THROW(co_await gen.next(), std::runtime_error);
+        EXPECT_EQ(co_await gen.next(), nullptr);
+        co_return first;
+    }(std::move(gen));
+    EXPECT_TRUE(result.is_ready());
+    EXPECT_EQ(result.get(), "first");
+}
+
+TEST(ReactorTest, GeneratorStopsAfterFailure) {
+    corey::Reactor reactor;
+    int produced = 0;
+
+    auto gen = [](int& produced) -> corey::AsyncGenerator<int> {
+        for (int i = 0; i < 3; ++i) {
+            if (i == 1) {
+                co_await std::make_exception_ptr(std::runtime_error("producer failed"));
+            }
+            ++produced;
+            co_yield i;
+        }
+    }(produced);
+
+    auto result = [](corey::AsyncGenerator<int> gen) -> corey::Future<int> {
+        int first = *co_await gen.next();
+        EXPECT_THROW(co_await gen.next(), std::runtime_error);
+        EXPECT_EQ(co_await gen.next(), nullptr);
+        EXPECT_EQ(co_await gen.next(), nullptr);
+        co_return first;
+    }(std::move(gen));
+    EXPECT_TRUE(result.is_ready());
+    EXPECT_EQ(result.get(), 0);
+    EXPECT_EQ(produced, 1);
+}
+
+TEST(ReactorTest, WhenAllWakesAwaiterOnce) {
+    corey::Reactor reactor;
+    auto bg = reactor.create_scheduling_group("bg", 100);
+    std::vector<corey::Promise<int>> promises(64);
+
+    auto sum = corey::with_scheduling_group(bg, [&promises] {
+        std::vector<corey::Future<int>> futures;
+        for (auto& promise: promises) {
+            futures.push_back(promise.get_future());
+        }
+        return [](std::vector<corey::Future<int>> futures) -> corey::Future<int> {
+            int sum = 0;
+            for (auto& fut: co_await corey::when_all(std::move(futures))) {
+                sum += fut.get();
+            }
+            co_return sum;
+        }(std::move(futures));
+    });
+
+    for (int idx = 0; idx < 64; ++idx) {
+        promises[idx].set(idx);
+    }
+    while (reactor.has_progress()) {
+        reactor.run();
+    }
+    EXPECT_EQ(sum.get(), 64 * 63 / 2);
+    EXPECT_EQ(bg.stats().tasks_run, 1u);
+}
+
+TEST(ReactorTest, SharedFutureResumesAllWaiters) {
+    corey::Reactor reactor;
+    corey::Promise<std::string> promise;
+    auto shared = promise.get_shared_future();
+    EXPECT_THROW({ std::ignore = promise.get_shared_future(); }, corey::FutureAlreadyRetrived);
+
+    auto waiter = [](corey::SharedFuture<std::string> shared) -> corey::Future<const std::string*> {
+        const auto& value = co_await shared;
+        co_return &value;
+    };
+    std::vector<corey::Future<const std::string*>> waiters;
+    for (int idx = 0; idx < 10; ++idx) {
+        waiters.push_back(waiter(shared));
+    }
+    reactor.run();
+    EXPECT_FALSE(shared.is_ready());
+
+    promise.set("value");
+    EXPECT_TRUE(shared.is_ready());
+    reactor.run();
+    for (auto& fut: waiters) {
+        ASSERT_TRUE(fut.is_ready());
+        EXPECT_EQ(fut.get(), &shared.get());
+    }
+    EXPECT_EQ(shared.get(), "value");
+}
+
+TEST(ReactorTest, SharedFuturePropagatesException) {
+    corey::Reactor reactor;
+    corey::Promise<> promise;
+    auto shared = promise.get_future().share();
+
+    auto waiter = [](corey::SharedFuture<> shared) -> corey::Future<> {
+        co_await shared;
+    };
+    auto first = waiter(shared);
+    auto second = waiter(shared);
+
+    promise.set_exception(std::make_exception_ptr(std::runtime_error("test")));
+    reactor.run();
+    EXPECT_TRUE(shared.has_failed());
+    EXPECT_THROW(first.get(), std::runtime_error);
+    EXPECT_THROW(second.get(), std::runtime_error);
+
+    auto late = waiter(shared);
+    EXPECT_THROW(late.get(), std::runtime_error);
+}
+
+TEST(ReactorTest, DroppedSharedFutureReleasesState) {
+    corey::Reactor reactor;
+    corey::Promise<std::string> promise;
+    {
+        auto shared = promise.get_shared_future();
+        auto copy = shared;
+        EXPECT_TRUE(promise.has_future());
+    }
+    // shared state dropped its source future, so nothing refers to promise
+    EXPECT_FALSE(promise.has_future());
+    promise.set("value");
+}
+
+TEST(ReactorTest, SchedulingGroupInheritedByContinuations) {
+    corey::Reactor reactor;
+    corey::Promise<> promise;
+    auto bg = reactor.create_scheduling_group("bg", 100);
+    EXPECT_EQ(bg.name(), "bg");
+    EXPECT_EQ(bg.shares(), 100u);
+    EXPECT_THROW({ std::ignore = reactor.create_scheduling_group("bg", 10); }, std::invalid_argument);
+    EXPECT_THROW({ std::ignore = reactor.create_scheduling_group("zero", 0); }, std::invalid_argument);
+
+    std::vector<corey::SchedulingGroup> seen;
+    auto coro = corey::with_scheduling_group(bg, [&]() {
+        return [](corey::Future<> fut, std::vector<corey::SchedulingGroup>& seen) -> corey::Future<> {
+            seen.push_back(corey::current_scheduling_group());
+            co_await std::move(fut);
+            seen.push_back(corey::current_scheduling_group());
+            co_await corey::yield();
+            seen.push_back(corey::current_scheduling_group());
+        }(promise.get_future(), seen);
+    });
+    EXPECT_EQ(reactor.current_scheduling_group(), corey::SchedulingGroup());
+
+    promise.set();
+    while (reactor.has_progress()) {
+        reactor.run();
+    }
+    EXPECT_TRUE(coro.is_ready());
+    EXPECT_EQ(seen, std::vector<corey::SchedulingGroup>(3, bg));
+    EXPECT_EQ(bg.stats().tasks_run, 2u);
+}
+
+TEST(ReactorTest, SchedulingGroupShares) {
+    corey::Reactor reactor;
+    auto fg = reactor.create_scheduling_group("fg", 1000);
+    auto bg = reactor.create_scheduling_group("bg", 100);
+
+    bool stop = false;
+    auto worker = [](int& runs, const bool& stop) -> corey::Future<> {
+        while (!stop) {
+            auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+            while (std::chrono::steady_clock::now() < until) {}
+            ++runs;
+            co_await corey::yield();
+        }
+    };
+    int fg_runs = 0;
+    int bg_runs = 0;
+    std::ignore = corey::with_scheduling_group(fg, [&] { return worker(fg_runs, stop); });
+    std::ignore = corey::with_scheduling_group(bg, [&] { return worker(bg_runs, stop); });
+
+    for (int i = 0; i < 220; ++i) {
+        reactor.run();
+    }
+    EXPECT_GT(fg_runs, 5 * bg_runs);
+    EXPECT_GT(bg_runs, 1);
+    EXPECT_GT(fg.stats().runtime, 5 * bg.stats().runtime);
+
+    stop = true;
+    while (reactor.has_progress()) {
+        reactor.run();
+    }
+}
+
+TEST(ReactorTest, MaybeYieldOnlyWhenPreempted) {
+    corey::Reactor reactor;
+    EXPECT_FALSE(corey::need_preempt());
+    EXPECT_THROW(reactor.set_task_quota(std::chrono::nanoseconds::zero()), std::invalid_argument);
+
+    int count = 0;
+    auto unpreempted = [](int& count) -> corey::Future<> {
+        for (int i = 0; i < 100; ++i) {
+            co_await corey::maybe_yield();
+            ++count;
+        }
+    }(count);
+    EXPECT_TRUE(unpreempted.is_ready());
+    EXPECT_EQ(count, 100);
+
+    reactor.set_task_quota(std::chrono::milliseconds(1));
+    int slices = 0;
+    std::optional<corey::Future<>> busy;
+    reactor.add_task(corey::make_task([&] {
+        busy = [](int& slices) -> corey::Future<> {
+            for (int i = 0; i < 3; ++i) {
+                while (!corey::need_preempt()) {}
+                ++slices;
+                co_await corey::maybe_yield();
+            }
+        }(slices);
+    }));
+
+    for (int pass = 1; pass <= 3; ++pass) {
+        reactor.run();
+        EXPECT_EQ(slices, pass);
+    }
+    reactor.run();
+    EXPECT_TRUE(busy->is_ready());
+}
+
+TEST(ReactorTest, StallDetectorCountsStalls) {
+    corey::Reactor reactor;
+    EXPECT_THROW(reactor.enable_stall_detector(std::chrono::nanoseconds::zero()), std::invalid_argument);
+    reactor.enable_stall_detector(std::chrono::milliseconds(5));
+    auto bg = reactor.create_scheduling_group("bg", 100);
+
+    auto spin = [](std::chrono::milliseconds duration) {
+        auto until = std::chrono::steady_clock::now() + duration;
+        while (std::chrono::steady_clock::now() < until) {}
+    };
+    reactor.add_task(corey::make_task([&] { spin(std::chrono::milliseconds(1)); }));
+    reactor.add_task(corey::make_task([&] { spin(std::chrono::milliseconds(50)); }), bg);
+    reactor.add_task(corey::make_task([&] { spin(std::chrono::milliseconds(50)); }), bg);
+    while (reactor.has_progress()) {
+        reactor.run();
+    }
+
+    EXPECT_EQ(corey::SchedulingGroup().stats().stalls, 0u);
+    EXPECT_EQ(bg.stats().stalls, 2u);
+    reactor.disable_stall_detector();
+}
+
+TEST(ReactorTest, PollerInterruptMode) {
+    struct Counters {
+        int events = 0;
+        int entered = 0;
+        int exited = 0;
+        int sleeps = 0;
+    } counters;
+
+    struct TestPoller final : corey::Poller {
+        Counters& counters;
+        explicit TestPoller(Counters& counters) : counters(counters) {}
+        bool poll() override { return std::exchange(counters.events, 0) > 0; }
+        bool pure_poll() override { return counters.events > 0; }
+        bool try_enter_interrupt_mode() override {
+            ++counters.entered;
+            return counters.events == 0;
+        }
+        void exit_interrupt_mode() override { ++counters.exited; }
+    };
+
+    corey::Reactor reactor;
+    auto poller = reactor.add_poller(std::make_unique<TestPoller>(counters));
+
+    // without sleeper reactor can only spin
+    reactor.run();
+    EXPECT_EQ(counters.entered, 0);
+
+    auto sleeper = reactor.set_sleeper([&counters] {
+        ++counters.sleeps;
+        counters.events = 1;
+    });
+    reactor.run();
+    EXPECT_EQ(counters.sleeps, 1);
+    EXPECT_EQ(counters.entered, 1);
+    EXPECT_EQ(counters.exited, 1);
+    EXPECT_EQ(counters.events, 0);
+    EXPECT_EQ(reactor.idle_stats().sleeps, 1u);
+
+    counters.events = 1;
+    reactor.run();
+    EXPECT_EQ(counters.sleeps, 1);
+    EXPECT_EQ(counters.entered, 1);
+}
+
+TEST(ReactorTest, IdleTaskRunsOnlyWhenIdle) {
+    corey::Reactor reactor;
+    int sleeps = 0;
+    auto sleeper = reactor.set_sleeper([&sleeps] { ++sleeps; });
+
+    int idle_runs = 0;
+    int attempts = 0;
+    reactor.add_idle_task(corey::make_task([&idle_runs] { ++idle_runs; }, [&attempts] { return ++attempts > 1; }));
+    bool regular = false;
+    reactor.add_task(corey::make_task([&regular] { regular = true; }));
+
+    reactor.run();
+    EXPECT_TRUE(regular);
+    EXPECT_EQ(idle_runs, 0);
+
+    // idle task keeps reactor awake until it is done
+    reactor.run();
+    EXPECT_EQ(idle_runs, 0);
+    EXPECT_EQ(sleeps, 0);
+    reactor.run();
+    EXPECT_EQ(idle_runs, 1);
+    EXPECT_EQ(sleeps, 0);
+    EXPECT_EQ(reactor.idle_stats().idle_tasks_run, 2u);
+
+    reactor.run();
+    EXPECT_EQ(sleeps, 1);
+}
+
+TEST(ReactorTest, CoroutineFramesReused) {
+#ifdef COREY_SYSTEM_FRAME_ALLOCATOR
+    GTEST_SKIP() << "frames are allocated with global operator new";
+#endif
+    corey::Reactor reactor;
+    auto coro = []() -> corey::Future<int> {
+        co_await corey::yield();
+        co_return 1;
+    };
+
+    auto before = corey::frame_allocator_stats();
+    for (int i = 0; i < 2; ++i) {
+        auto fut = coro();
+        while (!fut.is_ready()) {
+            reactor.run();
+        }
+    }
+    auto after = corey::frame_allocator_stats();
+    EXPECT_EQ(after.allocations - before.allocations, 2u);
+    EXPECT_GE(after.hits - before.hits, 1u);
+    EXPECT_GT(after.hit_rate(), 0.0);
+
+    auto types = corey::frame_type_stats();
+    auto type = std::ranges::find(types, "corey::CoroPromise<int>", &corey::FrameTypeStats::name);
+    ASSERT_NE(type, types.end());
+    EXPECT_GE(type->allocations, 2u);
+    EXPECT_GT(type->max_size, 0u);
+}
+
 class ReactorIOTest : public testing::Test {
 protected:
     void SetUp() override {
@@ -46,6 +579,268 @@ protected:
 
 
 
+TEST_F(ReactorIOTest, IdlePolicy) {
+    EXPECT_EQ(corey::parse_idle_policy("spin"), corey::IdlePolicy::spin);
+    EXPECT_THROW(corey::parse_idle_policy("nap"), std::invalid_argument);
+
+    auto wait = [this](std::chrono::nanoseconds timeout) {
+        auto fut = corey::sleep(timeout);
+        while (!fut.is_ready()) {
+            _reactor->run();
+        }
+    };
+
+    _reactor->set_idle_policy(corey::IdlePolicy::spin, std::chrono::seconds(1));
+    wait(std::chrono::milliseconds(1));
+    EXPECT_EQ(_reactor->idle_stats().sleeps, 0u);
+    EXPECT_GE(_reactor->idle_stats().spinning, std::chrono::microseconds(500));
+
+    _reactor->set_idle_policy(corey::IdlePolicy::block);
+    wait(std::chrono::milliseconds(1));
+    EXPECT_GT(_reactor->idle_stats().sleeps, 0u);
+    EXPECT_GT(_reactor->idle_stats().sleeping, std::chrono::nanoseconds::zero());
+}
+
+TEST_F(ReactorIOTest, AbortPendingRead) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    corey::AbortSource abort;
+    char buffer[16];
+    // requests are submitted, but reactor must not block on them
+    _reactor->set_idle_policy(corey::IdlePolicy::poll);
+
+    auto read = _io->read(fds[0], 0, std::span(buffer), &abort);
+    auto sleep = corey::sleep(std::chrono::seconds(10), &abort);
+    for (int pass = 0; pass < 3; ++pass) {
+        _reactor->run();
+    }
+    EXPECT_FALSE(read.is_ready());
+    EXPECT_FALSE(sleep.is_ready());
+
+    abort.request_abort();
+    while (!read.is_ready() || !sleep.is_ready()) {
+        _reactor->run();
+    }
+    EXPECT_EQ(read.get(), -ECANCELED);
+    try {
+        sleep.get();
+        FAIL() << "sleep was not aborted";
+    } catch (const std::system_error& err) {
+        EXPECT_EQ(err.code().value(), ECANCELED);
+    }
+
+    auto late = _io->read(fds[0], 0, std::span(buffer), &abort);
+    EXPECT_TRUE(late.is_ready());
+    EXPECT_EQ(late.get(), -ECANCELED);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST_F(ReactorIOTest, CompletedRequestIgnoresAbort) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    corey::AbortSource abort;
+    char buffer[16];
+
+    auto read = _io->read(fds[0], 0, std::span(buffer), &abort);
+    ASSERT_EQ(::write(fds[1], "data", 4), 4);
+    while (!read.is_ready()) {
+        _reactor->run();
+    }
+    EXPECT_EQ(read.get(), 4);
+
+    // subscription of completed request is gone, nothing to cancel
+    _reactor->set_idle_policy(corey::IdlePolicy::poll);
+    abort.request_abort();
+    EXPECT_TRUE(abort.abort_requested());
+    _reactor->run();
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST_F(ReactorIOTest, DeadlineCancelsRequest) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    char buffer[16];
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(5);
+
+    auto expired = _io->read(fds[0], 0, std::span(buffer), nullptr, deadline);
+    while (!expired.is_ready()) {
+        _reactor->run();
+    }
+    EXPECT_EQ(expired.get(), -ECANCELED);
+    EXPECT_GE(std::chrono::steady_clock::now(), deadline);
+
+    auto in_time = _io->read(fds[0], 0, std::span(buffer), nullptr, std::chrono::steady_clock::now() + std::chrono::seconds(10));
+    ASSERT_EQ(::write(fds[1], "data", 4), 4);
+    while (!in_time.is_ready()) {
+        _reactor->run();
+    }
+    EXPECT_EQ(in_time.get(), 4);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST_F(ReactorIOTest, BurstBeyondRingSize) {
+    constexpr auto burst = corey::max_events * 8;
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    int zero = open("/dev/zero", O_RDONLY);
+    ASSERT_NE(zero, -1);
+    corey::AbortSource abort;
+    char buffer[16];
+    _reactor->set_idle_policy(corey::IdlePolicy::poll);
+
+    std::vector<corey::Future<int>> ready;
+    std::vector<corey::Future<int>> pending;
+    for (unsigned i = 0; i < burst; ++i) {
+        ready.push_back(_io->read(zero, 0, std::span(buffer)));
+        pending.push_back(_io->read(fds[0], 0, std::span(buffer), &abort));
+    }
+    auto all_ready = [](auto& futures) {
+        return std::ranges::all_of(futures, [](auto& fut) { return fut.is_ready(); });
+    };
+    while (!all_ready(ready)) {
+        _reactor->run();
+    }
+    for (auto& fut : ready) {
+        EXPECT_EQ(fut.get(), int(sizeof(buffer)));
+    }
+    EXPECT_FALSE(std::ranges::any_of(pending, [](auto& fut) { return fut.is_ready(); }));
+
+    abort.request_abort();
+    while (!all_ready(pending)) {
+        _reactor->run();
+    }
+    for (auto& fut : pending) {
+        EXPECT_EQ(fut.get(), -ECANCELED);
+    }
+
+    ::close(zero);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST_F(ReactorIOTest, ConfiguredRing) {
+    _io.reset();
+    _io = std::make_unique<corey::IoEngine>(*_reactor, corey::IoEngineConfig{
+        .sq_entries = 8,
+        .cq_entries = 64,
+        .defer_taskrun = true,
+        .coop_taskrun = true,
+        .submit_all = true,
+    });
+    // flags missing in running kernel are dropped, but engine must work
+    auto flags = _io->setup_flags();
+    EXPECT_TRUE(flags & IORING_SETUP_CQSIZE);
+    if (flags & IORING_SETUP_DEFER_TASKRUN) {
+        EXPECT_TRUE(flags & IORING_SETUP_SINGLE_ISSUER);
+    }
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    char buffer[16];
+    std::vector<corey::Future<int>> reads;
+    for (int i = 0; i < 32; ++i) {
+        reads.push_back(_io->read(fds[0], 0, std::span(buffer, 1)));
+    }
+    auto sleep = corey::sleep(std::chrono::milliseconds(1));
+    while (!sleep.is_ready()) {
+        _reactor->run();
+    }
+    EXPECT_FALSE(reads.front().is_ready());
+
+    // completions wait for engine to enter kernel, blocking reactor must see them
+    std::string data(reads.size(), 'x');
+    ASSERT_EQ(::write(fds[1], data.data(), data.size()), ssize_t(data.size()));
+    while (!std::ranges::all_of(reads, [](auto& fut) { return fut.is_ready(); })) {
+        _reactor->run();
+    }
+    for (auto& fut : reads) {
+        EXPECT_EQ(fut.get(), 1);
+    }
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST_F(ReactorIOTest, InvalidRingSize) {
+    _io.reset();
+    auto make = [this](unsigned sq_entries, unsigned cq_entries) {
+        return std::make_unique<corey::IoEngine>(*_reactor, corey::IoEngineConfig{
+            .sq_entries = sq_entries,
+            .cq_entries = cq_entries,
+        });
+    };
+    // rejected before flags are tried, so they are not dropped as unsupported
+    EXPECT_THROW(make(0, 0), std::invalid_argument);
+    EXPECT_THROW(make(64, 32), std::invalid_argument);
+    EXPECT_THROW(make(1u << 20, 0), std::invalid_argument);
+    EXPECT_THROW(make(64, 1u << 20), std::invalid_argument);
+    _io = make(64, 128);
+}
+
+TEST_F(ReactorIOTest, SqPollRing) {
+    _io.reset();
+    _io = std::make_unique<corey::IoEngine>(*_reactor, corey::IoEngineConfig{
+        .sq_entries = 16,
+        .sq_poll = true,
+        .sq_thread_idle = std::chrono::milliseconds(100),
+    });
+    int zero = open("/dev/zero", O_RDONLY);
+    ASSERT_NE(zero, -1);
+    char buffer[16];
+
+    for (int i = 0; i < 100; ++i) {
+        auto read = _io->read(zero, 0, std::span(buffer));
+        while (!read.is_ready()) {
+            _reactor->run();
+        }
+        EXPECT_EQ(read.get(), int(sizeof(buffer)));
+    }
+    // more requests than submission queue entries, SQ thread frees them
+    std::vector<corey::Future<int>> burst;
+    for (int i = 0; i < 256; ++i) {
+        burst.push_back(_io->read(zero, 0, std::span(buffer)));
+    }
+    while (!std::ranges::all_of(burst, [](auto& fut) { return fut.is_ready(); })) {
+        _reactor->run();
+    }
+    for (auto& fut : burst) {
+        EXPECT_EQ(fut.get(), int(sizeof(buffer)));
+    }
+    // SQ thread may be refused, then requests are submitted by syscalls
+    if (_io->setup_flags() & IORING_SETUP_SQPOLL) {
+        EXPECT_LT(_io->stats().submit_syscalls, _io->stats().requests);
+    }
+
+    ::close(zero);
+}
+
+TEST_F(ReactorIOTest, DestroyCompletesInflightRequests) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    char buffer[16];
+    _reactor->set_idle_policy(corey::IdlePolicy::poll);
+
+    auto submitted = _io->read(fds[0], 0, std::span(buffer), nullptr, std::chrono::steady_clock::now() + std::chrono::hours(1));
+    _reactor->run();
+    auto prepared = _io->read(fds[0], 0, std::span(buffer));
+    EXPECT_FALSE(submitted.is_ready());
+
+    _io.reset();
+    ASSERT_TRUE(submitted.is_ready());
+    ASSERT_TRUE(prepared.is_ready());
+    EXPECT_EQ(submitted.get(), -ECANCELED);
+    EXPECT_EQ(prepared.get(), -ECANCELED);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
 TEST_F(ReactorIOTest, IoEngineRead) {
     int fd = open("/dev/zero", O_RDONLY);
     ASSERT_NE(fd, -1);
@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+
+#include <utils/result.hh>
+
+#include <memory>
+#include <system_error>
+
+TEST(ResultTest, HoldsValue) {
+    corey::Result<std::unique_ptr<int>> result(std::make_unique<int>(42));
+    EXPECT_TRUE(result);
+    EXPECT_FALSE(result.error());
+    EXPECT_EQ(**result, 42);
+    auto value = corey::value_or_throw(std::move(result), "failed");
+    EXPECT_EQ(*value, 42);
+}
+
+TEST(ResultTest, HoldsError) {
+    corey::Result<int> result(std::make_error_code(std::errc::connection_reset));
+    EXPECT_FALSE(result.has_value());
+    EXPECT_EQ(result.error(), std::errc::connection_reset);
+    EXPECT_THROW(result.value(), std::system_error);
+    try {
+        corey::value_or_throw(std::move(result), "recv failed");
+        FAIL() << "error was not thrown";
+    } catch (const std::system_error& err) {
+        EXPECT_EQ(err.code(), std::errc::connection_reset);
+    }
+}
+
+TEST(ResultTest, VoidResult) {
+    corey::Result<> ok;
+    EXPECT_TRUE(ok);
+    EXPECT_NO_THROW(ok.value());
+
+    corey::Result<> failed(std::make_error_code(std::errc::bad_file_descriptor));
+    EXPECT_FALSE(failed);
+    EXPECT_THROW(corey::value_or_throw(std::move(failed), "close failed"), std::system_error);
+}
@@ -0,0 +1,217 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "corey.hh"
+#include "reactor/spsc.hh"
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <vector>
+
+TEST(Smp, ParseCpuset) {
+    EXPECT_THAT(corey::parse_cpuset("0"), testing::ElementsAre(0));
+    EXPECT_THAT(corey::parse_cpuset("0-3,8"), testing::ElementsAre(0, 1, 2, 3, 8));
+    EXPECT_THAT(corey::parse_cpuset("5,1-2"), testing::ElementsAre(5, 1, 2));
+
+    EXPECT_THROW({ std::ignore = corey::parse_cpuset(""); }, std::invalid_argument);
+    EXPECT_THROW({ std::ignore = corey::parse_cpuset("3-1"); }, std::invalid_argument);
+    EXPECT_THROW({ std::ignore = corey::parse_cpuset("a"); }, std::invalid_argument);
+    EXPECT_THROW({ std::ignore = corey::parse_cpuset("1,"); }, std::invalid_argument);
+}
+
+TEST(Smp, SingleShardByDefault) {
+    corey::Application app(0, nullptr);
+    auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
+        EXPECT_EQ(corey::Smp::shard_id(), 0);
+        co_return corey::Smp::count();
+    });
+    EXPECT_EQ(result, 1);
+}
+
+TEST(Smp, ServicesStartedOnEveryShard) {
+    using namespace std::chrono_literals;
+
+    char* args[] = {
+        const_cast<char*>("test"),
+        const_cast<char*>("--smp=3")
+    };
+    corey::Application app(std::extent_v<decltype(args)>, args);
+
+    std::mutex mutex;
+    std::set<corey::ShardId> shards;
+    app.add_shard_service([&](const corey::ParseResult&) -> corey::Future<> {
+        // every shard must have its own reactor and io engine
+        co_await corey::sleep(1ms);
+        std::lock_guard lock(mutex);
+        shards.insert(corey::Smp::shard_id());
+    });
+
+    auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
+        EXPECT_EQ(corey::Smp::shard_id(), 0);
+        co_await corey::sleep(100ms);
+        co_return corey::Smp::count();
+    });
+    EXPECT_EQ(result, 3);
+    EXPECT_EQ(corey::Smp::count(), 1);
+    EXPECT_THAT(shards, testing::ElementsAre(0, 1, 2));
+}
+
+TEST(Smp, SmpGreaterThanCpuset) {
+    char* args[] = {
+        const_cast<char*>("test"),
+        const_cast<char*>("--smp=2"),
+        const_cast<char*>("--cpuset=0")
+    };
+    corey::Application app(std::extent_v<decltype(args)>, args);
+    EXPECT_THROW({
+        app.run([](const corey::ParseResult&) -> corey::Future<int> { co_return 0; });
+    }, std::invalid_argument);
+}
+
+TEST(Smp, NumaAwarePlacement) {
+    char* args[] = {
+        const_cast<char*>("test"),
+        const_cast<char*>("--smp=2"),
+        const_cast<char*>("--numa-aware")
+    };
+    corey::Application app(std::extent_v<decltype(args)>, args);
+
+    auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
+        auto remote = co_await corey::submit_to(1, [] { return corey::Smp::placement(corey::Smp::shard_id()); });
+        EXPECT_TRUE(remote.has_value());
+        EXPECT_EQ(remote->node, corey::get_numa_node(remote->cpu));
+        co_return corey::Smp::count();
+    });
+    EXPECT_EQ(result, 2);
+    EXPECT_FALSE(corey::Smp::placement(0).has_value());
+}
+
+TEST(Smp, NumaAwareRequiresShards) {
+    char* args[] = {
+        const_cast<char*>("test"),
+        const_cast<char*>("--numa-aware")
+    };
+    corey::Application app(std::extent_v<decltype(args)>, args);
+    EXPECT_THROW({
+        app.run([](const corey::ParseResult&) -> corey::Future<int> { co_return 0; });
+    }, std::invalid_argument);
+}
+
+TEST(Smp, ShutdownCancelsPendingServices) {
+    using namespace std::chrono_literals;
+
+    char* args[] = {
+        const_cast<char*>("test"),
+        const_cast<char*>("--smp=2")
+    };
+    std::atomic<int> cancelled = 0;
+    {
+        corey::Application app(std::extent_v<decltype(args)>, args);
+        app.add_shard_service([&cancelled](const corey::ParseResult&) -> corey::Future<> {
+            try {
+                co_await corey::sleep(1h);
+            } catch (const std::system_error& e) {
+                if (e.code().value() == ECANCELED) {
+                    ++cancelled;
+                }
+            }
+        });
+        auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
+            co_await corey::sleep(10ms);
+            co_return 0;
+        });
+        EXPECT_EQ(result, 0);
+    }
+    EXPECT_EQ(cancelled, 2);
+}
+
+TEST(Smp, SpscQueueBatches) {
+    corey::SpscQueue<int, 4> queue;
+    std::vector<int> received;
+    auto collect = [&received](int item) { received.push_back(item); };
+
+    EXPECT_TRUE(queue.try_push(1));
+    EXPECT_TRUE(queue.try_push(2));
+    EXPECT_EQ(queue.consume(collect), 0);
+
+    EXPECT_TRUE(queue.publish());
+    EXPECT_FALSE(queue.publish());
+    EXPECT_EQ(queue.consume(collect), 2);
+
+    for (int i = 3; i < 7; ++i) {
+        EXPECT_TRUE(queue.try_push(std::move(i)));
+    }
+    EXPECT_FALSE(queue.try_push(7));
+    queue.publish();
+    EXPECT_EQ(queue.consume(collect), 4);
+    EXPECT_THAT(received, testing::ElementsAre(1, 2, 3, 4, 5, 6));
+}
+
+class SmpTest : public testing::Test {
+protected:
+    char* args[2] = {
+        const_cast<char*>("test"),
+        const_cast<char*>("--smp=2")
+    };
+    corey::Application app{std::extent_v<decltype(args)>, args};
+};
+
+TEST_F(SmpTest, SubmitTo) {
+    auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
+        auto shard = co_await corey::submit_to(1, [] { return corey::Smp::shard_id(); });
+        EXPECT_EQ(shard, 1);
+
+        bool called = false;
+        co_await corey::submit_to(1, [&called] { called = true; });
+        EXPECT_TRUE(called);
+
+        auto local = co_await corey::submit_to(0, [] { return corey::Smp::shard_id(); });
+        EXPECT_EQ(local, 0);
+
+        auto slept = co_await corey::submit_to(1, []() -> corey::Future<corey::ShardId> {
+            co_await corey::sleep(std::chrono::milliseconds(1));
+            co_return corey::Smp::shard_id();
+        });
+        EXPECT_EQ(slept, 1);
+
+        auto nested = co_await corey::submit_to(1, [] {
+            return corey::submit_to(0, [] { return corey::Smp::shard_id() + 10; });
+        });
+        EXPECT_EQ(nested, 10);
+        co_return 0;
+    });
+    EXPECT_EQ(result, 0);
+}
+
+TEST_F(SmpTest, SubmitToException) {
+    auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
+        EXPECT_THROW(co_await corey::submit_to(1, []() -> int {
+            throw std::runtime_error("remote");
+        }), std::runtime_error);
+
+        EXPECT_THROW(co_await corey::submit_to(1, []() -> corey::Future<> {
+            co_await std::make_exception_ptr(std::runtime_error("remote"));
+        }), std::runtime_error);
+
+        EXPECT_THROW(co_await corey::submit_to(2, [] {}), std::out_of_range);
+        co_return 0;
+    });
+    EXPECT_EQ(result, 0);
+}
+
+TEST_F(SmpTest, SubmitToBurst) {
+    auto result = app.run([](const corey::ParseResult&) -> corey::Future<int> {
+        constexpr int burst = 1000;
+        std::vector<corey::Future<int>> replies;
+        for (int i = 0; i < burst; ++i) {
+            replies.push_back(corey::submit_to(1, [i] { return i; }));
+        }
+        int sum = 0;
+        for (auto& reply: replies) {
+            sum += co_await std::move(reply);
+        }
+        co_return sum;
+    });
+    EXPECT_EQ(result, 999 * 1000 / 2);
+}
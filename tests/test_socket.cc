@@ -106,4 +106,42 @@ TEST_F(SocketTest, TestSocketPanic) {
         co_return 0;
     });
     EXPECT_EQ(result, 0);
-}
\ No newline at end of file
+}
+
+TEST_F(SocketTest, TestSocketTryApi) {
+    auto result = app->run([](const auto&) -> corey::Future<int> {
+
+        corey::Socket sock;
+        auto closed = co_await sock.try_close();
+        EXPECT_EQ(closed.error(), std::errc::bad_file_descriptor);
+
+        auto refused = co_await corey::Socket::try_make_tcp_connect("127.0.0.1", TEST_SOCK + 1);
+        EXPECT_FALSE(refused);
+        EXPECT_EQ(refused.error(), std::errc::connection_refused);
+
+        auto listener = co_await corey::Socket::try_make_tcp_listener(TEST_SOCK);
+        EXPECT_TRUE(listener);
+
+        auto client_fib = []() -> corey::Future<> {
+            auto client = co_await corey::Socket::try_make_tcp_connect("127.0.0.1", TEST_SOCK);
+            EXPECT_TRUE(client);
+            std::string message = "ping";
+            auto size = co_await client->try_write(std::span(message));
+            EXPECT_EQ(size.value(), message.size());
+            EXPECT_TRUE(co_await client->try_close());
+        }();
+
+        auto client_sock = co_await listener->try_accept();
+        EXPECT_TRUE(client_sock);
+        char buffer[16];
+        auto size = co_await client_sock->try_read(std::span(buffer));
+        EXPECT_EQ(std::string(buffer, size.value()), "ping");
+        EXPECT_TRUE(co_await client_sock->try_close());
+        EXPECT_TRUE(co_await listener->try_close());
+
+        co_await std::move(client_fib);
+        co_return 0;
+    });
+
+    EXPECT_EQ(result, 0);
+}
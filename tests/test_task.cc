@@ -1,11 +1,15 @@
+#include "reactor/circular_buffer.hh"
 #include "reactor/task.hh"
 #include "utils/log.hh"
 
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <array>
+#include <memory>
 #include <stdexcept>
 #include <typeinfo>
+#include <vector>
 
 TEST(TaskTest, Execute) {
     bool executed = false;
@@ -31,6 +35,46 @@ TEST(TaskTest, MoveAssignmentOperator) {
     EXPECT_TRUE(executed);
 }
 
+TEST(TaskTest, LargeCallableMovedWithoutCopy) {
+    std::array<int, 32> data = {};
+    data.back() = 42;
+    int result = 0;
+    auto owned = std::make_shared<int>(0);
+
+    auto task1 = corey::make_task([data, &result, owned]() { result = data.back(); });
+    auto task2 = std::move(task1);
+    EXPECT_FALSE(task1);
+    EXPECT_EQ(owned.use_count(), 2);
+    task2.try_execute();
+    EXPECT_EQ(result, 42);
+
+    task2 = corey::Executable();
+    EXPECT_EQ(owned.use_count(), 1);
+}
+
+TEST(TaskTest, CircularBufferKeepsOrderWhenGrowing) {
+    corey::CircularBuffer<std::unique_ptr<int>> buffer;
+    std::vector<int> popped;
+    // shift head so that growing has to unwrap the ring
+    for (int idx = 0; idx < 10; ++idx) {
+        buffer.push_back(std::make_unique<int>(-1));
+        buffer.pop_front();
+    }
+    for (int idx = 0; idx < 40; ++idx) {
+        buffer.push_back(std::make_unique<int>(idx));
+    }
+    EXPECT_EQ(buffer.size(), 40u);
+    EXPECT_EQ(buffer.capacity(), 64u);
+    while (!buffer.empty()) {
+        popped.push_back(*buffer.front());
+        buffer.pop_front();
+    }
+    EXPECT_EQ(popped.size(), 40u);
+    for (int idx = 0; idx < 40; ++idx) {
+        EXPECT_EQ(popped[idx], idx);
+    }
+}
+
 class MockExecutable : public corey::AbstractExecutable {
 public:
     MOCK_METHOD(bool, execute, (), (override));